@@ -0,0 +1,559 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Single-threaded benchmark for every Collection implementation
+(the source of the tables in Runtime Data.pdf). For each collection, key
+distribution and size it inserts n keys, then times find (hits and misses),
+find_batch() over the hits (64 keys per call, reported per key), range
+find, keys(), sort(), parallel_keys() and parallel_sort() (on the shared
+thread pool) and remove. Each row reports the mean ns per op, the
+50th/90th/99th percentile and max over batches of ops, and the peak
+resident set size of the case. Every case runs in its own process so the
+peak RSS belongs to that collection alone (it also counts the key arrays
+the benchmark itself holds, the same for every collection).
+
+Distributions:
+	sequential  keys 0, 2, 4, ... inserted, found and removed in order
+	random      keys scattered over the whole key range, inserted and
+	            removed in random order and found uniformly at random
+	zipf        the random keys, found with Zipf(0.99) popularity (a few
+	            hot keys get most of the finds)
+Misses are odd keys, which are never inserted. A range find asks for the
+keys spanning 100 consecutive keys. Collections that scan everything for an
+op (e.g. find in VectorCollection or range find in a hash table) run fewer
+ops of it, and the collections that are quadratic to fill are only run up
+to the largest size that finishes in seconds.
+
+Built with -DCOLLECTION_METRICS (make benchmark_metrics), --metrics writes
+the collections' own metrics (see instrumentation.h) over the whole run to
+a file, as a summary table or Prometheus text. The metrics live in the
+benchmark process, so --metrics runs every case in it (--no-fork).
+
+usage: benchmark [--sizes n,...] [--collections name,...] [--distributions name,...]
+                 [--format csv|json] [--max-ops n] [--no-fork]
+                 [--metrics path] [--metrics-format text|prometheus]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "collection.h"
+#include "vector_collection.h"
+#include "binsearch_collection.h"
+#include "linked_list_collection.h"
+#include "hash_table_collection.h"
+#include "open_hash_table_collection.h"
+#include "concurrent_hash_table_collection.h"
+#include "concurrent_skiplist_collection.h"
+#include "bst_collection.h"
+#include "dbl_rbt_collection.h"
+#include "persistent_rbt_collection.h"
+#include "btree_collection.h"
+#include "packed_array_collection.h"
+#include "instrumentation.h"
+
+
+// key distributions
+enum Distribution { SEQUENTIAL, RANDOM, ZIPF, DISTRIBUTIONS };
+const char* distribution_names[DISTRIBUTIONS] = {"sequential", "random", "zipf"};
+
+// ops that scan the whole collection (bit flags)
+const int LINEAR_FIND = 1;
+const int LINEAR_REMOVE = 2;
+const int LINEAR_RANGE = 4;
+
+// keys spanned by one range find
+const int range_width = 100;
+
+// most element visits allowed for the ops of a case that scan everything
+const double linear_budget = 2e8;
+
+
+// benchmark settings
+struct Settings {
+	std::vector<long> sizes;
+	std::vector<std::string> collections;
+	std::vector<int> distributions;
+	bool json;
+	long max_ops;
+	bool fork_cases;
+	// file to dump the collection metrics to (empty for none)
+	std::string metrics_path;
+	bool metrics_prometheus;
+};
+
+
+// timing of one op in one case (plain data so a case can send it through a pipe)
+struct Result {
+	char op[16];
+	long ops;
+	double ns_per_op;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+	long peak_rss_kb;
+};
+
+
+// keys and lookups for one case
+struct Workload {
+	// keys in insertion order
+	std::vector<long> keys;
+	// the same keys in ascending order
+	std::vector<long> sorted;
+	// keys to find (all present) and to miss (all absent)
+	std::vector<long> hits;
+	std::vector<long> misses;
+	// first and last key of each range find
+	std::vector<std::pair<long,long>> ranges;
+	// keys to remove
+	std::vector<long> removes;
+	// number of keys() and sort() calls
+	long reps;
+};
+
+
+// draws ranks 0..n-1 with P(r) proportional to 1/(r+1)^theta (the method
+// of Gray et al., "Quickly Generating Billion-Record Synthetic Databases")
+class Zipf {
+public:
+	Zipf(long n, double theta): n(n), theta(theta) {
+		double zeta2 = 1 + std::pow(0.5, theta);
+		zetan = 0;
+		for (long i = 1; i <= n; i++)
+			zetan += 1 / std::pow(static_cast<double>(i), theta);
+		alpha = 1 / (1 - theta);
+		eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+	}
+	long next(std::mt19937_64& rng) {
+		double u = std::uniform_real_distribution<double>(0, 1)(rng);
+		double uz = u * zetan;
+		if (uz < 1)
+			return 0;
+		if (uz < 1 + std::pow(0.5, theta))
+			return 1;
+		long r = static_cast<long>(n * std::pow(eta * u - eta + 1, alpha));
+		return std::min(r, n - 1);
+	}
+private:
+	long n;
+	double theta;
+	double zetan;
+	double alpha;
+	double eta;
+};
+
+
+// a bijection on 62 bit values that scatters consecutive inputs
+long scatter(long x) {
+	const unsigned long mask = (1UL << 62) - 1;
+	unsigned long h = x;
+	h ^= h >> 31;
+	h = (h * 0x9e3779b97f4a7c15UL) & mask;
+	h ^= h >> 29;
+	h = (h * 0xbf58476d1ce4e5b9UL) & mask;
+	h ^= h >> 32;
+	return h;
+}
+
+
+// number of timed ops: at most max_ops, and for an op that scans the
+// collection few enough to stay within the work budget
+long op_count(long n, long max_ops, bool linear) {
+	long ops = std::min(n, max_ops);
+	if (linear)
+		ops = std::min(ops, std::max(10L, static_cast<long>(linear_budget / n)));
+	return ops;
+}
+
+
+// build the keys and lookups of a case
+void make_workload(Distribution d, long n, long max_ops, int linear, Workload& w) {
+	std::mt19937_64 rng(n * 31 + d);
+	w.keys.resize(n);
+	for (long i = 0; i < n; i++)
+		w.keys[i] = d == SEQUENTIAL ? 2 * i : 2 * scatter(i);
+	if (d != SEQUENTIAL)
+		std::shuffle(w.keys.begin(), w.keys.end(), rng);
+	w.sorted = w.keys;
+	std::sort(w.sorted.begin(), w.sorted.end());
+
+	long finds = op_count(n, max_ops, linear & LINEAR_FIND);
+	w.hits.resize(finds);
+	w.misses.resize(finds);
+	if (d == ZIPF) {
+		Zipf zipf(n, 0.99);
+		for (long i = 0; i < finds; i++)
+			w.hits[i] = w.keys[zipf.next(rng)];
+	}
+	for (long i = 0; i < finds; i++) {
+		if (d == SEQUENTIAL)
+			w.hits[i] = w.keys[i];
+		else if (d == RANDOM)
+			w.hits[i] = w.keys[rng() % n];
+		w.misses[i] = (d == SEQUENTIAL ? w.keys[i] : w.hits[i]) + 1;
+	}
+
+	long ranges = op_count(std::min(n, 1000L), max_ops, linear & LINEAR_RANGE);
+	for (long i = 0; i < ranges; i++) {
+		long first = d == SEQUENTIAL ? i * (n / ranges) : rng() % n;
+		long last = std::min(first + range_width - 1, n - 1);
+		w.ranges.push_back(std::make_pair(w.sorted[first], w.sorted[last]));
+	}
+
+	long removes = op_count(n, max_ops, linear & LINEAR_REMOVE);
+	w.removes.assign(w.keys.begin(), w.keys.begin() + removes);
+
+	w.reps = std::max(1L, std::min(10L, static_cast<long>(linear_budget / 10 / n)));
+}
+
+
+// time f(i) for i in 0..ops-1 in batches and return the stats
+template <typename F>
+Result time_ops(const char* op, long ops, F f) {
+	long batch = ops >= 1000 ? 100 : std::max(1L, ops / 10);
+	std::vector<double> batches;
+	double total = 0;
+	for (long start = 0; start < ops; start += batch) {
+		long end = std::min(start + batch, ops);
+		auto t0 = std::chrono::steady_clock::now();
+		for (long i = start; i < end; i++)
+			f(i);
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - t0;
+		total += elapsed.count();
+		batches.push_back(elapsed.count() / (end - start));
+	}
+	std::sort(batches.begin(), batches.end());
+	Result r;
+	std::memset(&r, 0, sizeof(r));
+	std::strncpy(r.op, op, sizeof(r.op) - 1);
+	r.ops = ops;
+	r.ns_per_op = ops ? total / ops : 0;
+	if (!batches.empty()) {
+		r.p50 = batches[batches.size() * 50 / 100];
+		r.p90 = batches[batches.size() * 90 / 100];
+		r.p99 = batches[batches.size() * 99 / 100];
+		r.max = batches.back();
+	}
+	return r;
+}
+
+
+// peak resident set size of this process in KB
+long peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+
+// BinSearchCollection with its Eytzinger read index built after the inserts
+template <typename K, typename V>
+class EytzingerBinSearch : public BinSearchCollection<K,V> {};
+
+
+// called between the inserts and the reads (nothing for most collections)
+template <typename C>
+void before_reads(C&) {}
+
+template <typename K, typename V>
+void before_reads(EytzingerBinSearch<K,V>& c) {
+	c.build_read_index();
+}
+
+
+// keys per find_batch() call in the find-batch op
+const int find_batch_keys = 64;
+
+
+// turn the stats of r from per call into per key, for calls of keys keys
+void per_key(Result& r, int keys) {
+	r.ops *= keys;
+	r.ns_per_op /= keys;
+	r.p50 /= keys;
+	r.p90 /= keys;
+	r.p99 /= keys;
+	r.max /= keys;
+}
+
+
+// the checksum of each case's results is stored here, so the compiler
+// cannot drop the finds that produce it
+volatile long checksum_sink;
+
+
+// run every op on collection type C
+template <typename C>
+void run_case(const Workload& w, std::vector<Result>& results) {
+	C c;
+	// keep the results of the finds from being optimized away
+	long sum = 0;
+	std::vector<long> ks;
+
+	results.push_back(time_ops("insert", w.keys.size(), [&](long i) {
+		c.insert(w.keys[i], i);
+	}));
+	before_reads(c);
+	results.push_back(time_ops("find-hit", w.hits.size(), [&](long i) {
+		long val;
+		if (c.find(w.hits[i], val))
+			sum += val;
+	}));
+	results.push_back(time_ops("find-miss", w.misses.size(), [&](long i) {
+		long val;
+		if (c.find(w.misses[i], val))
+			sum += val;
+	}));
+	// the hits looked up find_batch_keys at a time, reported per key
+	std::vector<long> vals(find_batch_keys);
+	std::vector<bool> found;
+	Result batched = time_ops("find-batch", w.hits.size() / find_batch_keys, [&](long i) {
+		c.find_batch(&w.hits[i * find_batch_keys], find_batch_keys, vals.data(), found);
+		sum += found[0] ? vals[0] : 0;
+	});
+	per_key(batched, find_batch_keys);
+	results.push_back(batched);
+	results.push_back(time_ops("range", w.ranges.size(), [&](long i) {
+		c.find(w.ranges[i].first, w.ranges[i].second, ks);
+		sum += ks.size();
+	}));
+	results.push_back(time_ops("keys", w.reps, [&](long) {
+		c.keys(ks);
+		sum += ks.size();
+	}));
+	results.push_back(time_ops("sort", w.reps, [&](long) {
+		c.sort(ks);
+		sum += ks.size();
+	}));
+	results.push_back(time_ops("par-keys", w.reps, [&](long) {
+		c.parallel_keys(ks, ThreadPool::shared());
+		sum += ks.size();
+	}));
+	results.push_back(time_ops("par-sort", w.reps, [&](long) {
+		c.parallel_sort(ks, ThreadPool::shared());
+		sum += ks.size();
+	}));
+	results.push_back(time_ops("remove", w.removes.size(), [&](long i) {
+		c.remove(w.removes[i]);
+	}));
+
+	long rss = peak_rss_kb();
+	for (Result& r : results)
+		r.peak_rss_kb = rss;
+	checksum_sink = sum;
+}
+
+
+// a collection under test
+struct Entry {
+	const char* name;
+	void (*run)(const Workload& w, std::vector<Result>& results);
+	// ops that scan the whole collection
+	int linear;
+	// ops that scan the whole collection on sequential keys (the BST
+	// degenerates to a list)
+	int linear_sequential;
+	// largest size to run for each distribution
+	long max_size[DISTRIBUTIONS];
+};
+
+const Entry entries[] = {
+	{"Vector", run_case<VectorCollection<long,long>>, LINEAR_FIND | LINEAR_REMOVE | LINEAR_RANGE, 0,
+		{100000, 100000, 100000}},
+	{"LinkedList", run_case<LinkedListCollection<long,long>>, LINEAR_FIND | LINEAR_REMOVE | LINEAR_RANGE, 0,
+		{100000, 100000, 100000}},
+	{"LinkedHash", run_case<LinkedHashCollection<long,long>>, LINEAR_RANGE, 0,
+		{10000000, 10000000, 10000000}},
+	{"BinSearch", run_case<BinSearchCollection<long,long>>, LINEAR_REMOVE, 0,
+		{10000000, 100000, 100000}},
+	{"BinSearchEytzinger", run_case<EytzingerBinSearch<long,long>>, LINEAR_REMOVE, 0,
+		{10000000, 100000, 100000}},
+	{"HashTable", run_case<HashTableCollection<long,long>>, LINEAR_RANGE, 0,
+		{10000000, 10000000, 10000000}},
+	{"OpenHashTable", run_case<OpenHashTableCollection<long,long>>, LINEAR_RANGE, 0,
+		{10000000, 10000000, 10000000}},
+	{"ConcurrentHashTable", run_case<ConcurrentHashTableCollection<long,long>>, LINEAR_RANGE, 0,
+		{10000000, 10000000, 10000000}},
+	{"ConcurrentSkipList", run_case<ConcurrentSkipListCollection<long,long>>, 0, 0,
+		{10000000, 10000000, 10000000}},
+	{"BST", run_case<BSTCollection<long,long>>, 0, LINEAR_FIND | LINEAR_REMOVE | LINEAR_RANGE,
+		{10000, 10000000, 10000000}},
+	{"RBT", run_case<RBTCollection<long,long>>, 0, 0,
+		{10000000, 10000000, 10000000}},
+	{"PersistentRBT", run_case<PersistentRBTCollection<long,long>>, 0, 0,
+		{10000000, 10000000, 10000000}},
+	{"BTree", run_case<BTreeCollection<long,long>>, 0, 0,
+		{10000000, 10000000, 10000000}},
+	{"PackedArray", run_case<PackedArrayCollection<long,long>>, 0, 0,
+		{10000000, 10000000, 10000000}},
+};
+
+
+// run one case, in a child process unless fork_cases is off; returns
+// false if the case crashed
+bool run_entry(const Entry& e, Distribution d, long n, const Settings& s, std::vector<Result>& results) {
+	int linear = e.linear | (d == SEQUENTIAL ? e.linear_sequential : 0);
+	if (!s.fork_cases) {
+		Workload w;
+		make_workload(d, n, s.max_ops, linear, w);
+		e.run(w, results);
+		return true;
+	}
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+	pid_t pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0) {
+		close(fds[0]);
+		Workload w;
+		make_workload(d, n, s.max_ops, linear, w);
+		std::vector<Result> child_results;
+		e.run(w, child_results);
+		for (const Result& r : child_results)
+			if (write(fds[1], &r, sizeof(r)) != sizeof(r))
+				_exit(1);
+		_exit(0);
+	}
+	close(fds[1]);
+	Result r;
+	while (read(fds[0], &r, sizeof(r)) == sizeof(r))
+		results.push_back(r);
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+// print the rows of one case
+void print_results(const Entry& e, Distribution d, long n, const std::vector<Result>& results,
+                   bool json, bool& first_row) {
+	for (const Result& r : results) {
+		std::ostringstream row;
+		row << std::fixed << std::setprecision(1);
+		if (json) {
+			row << (first_row ? "  " : ",\n  ") << "{\"collection\": \"" << e.name
+			    << "\", \"distribution\": \"" << distribution_names[d] << "\", \"size\": " << n
+			    << ", \"op\": \"" << r.op << "\", \"ops\": " << r.ops << ", \"ns_per_op\": " << r.ns_per_op
+			    << ", \"p50_ns\": " << r.p50 << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99
+			    << ", \"max_ns\": " << r.max << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+			std::cout << row.str() << std::flush;
+		}
+		else {
+			row << e.name << "," << distribution_names[d] << "," << n << "," << r.op << "," << r.ops << ","
+			    << r.ns_per_op << "," << r.p50 << "," << r.p90 << "," << r.p99 << "," << r.max << ","
+			    << r.peak_rss_kb;
+			std::cout << row.str() << std::endl;
+		}
+		first_row = false;
+	}
+}
+
+
+// split a comma separated list
+std::vector<std::string> split(const std::string& list) {
+	std::vector<std::string> items;
+	std::stringstream in(list);
+	std::string item;
+	while (std::getline(in, item, ','))
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+
+int main(int argc, char** argv) {
+	Settings s;
+	s.sizes = {1000, 10000, 100000, 1000000, 10000000};
+	s.distributions = {SEQUENTIAL, RANDOM, ZIPF};
+	s.json = false;
+	s.max_ops = 1000000;
+	s.fork_cases = true;
+	s.metrics_prometheus = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--sizes" && has_value) {
+			s.sizes.clear();
+			for (const std::string& n : split(argv[++i]))
+				s.sizes.push_back(std::atol(n.c_str()));
+		}
+		else if (arg == "--collections" && has_value)
+			s.collections = split(argv[++i]);
+		else if (arg == "--distributions" && has_value) {
+			s.distributions.clear();
+			for (const std::string& name : split(argv[++i]))
+				for (int d = 0; d < DISTRIBUTIONS; d++)
+					if (name == distribution_names[d])
+						s.distributions.push_back(d);
+		}
+		else if (arg == "--format" && has_value)
+			s.json = std::string(argv[++i]) == "json";
+		else if (arg == "--max-ops" && has_value)
+			s.max_ops = std::atol(argv[++i]);
+		else if (arg == "--no-fork")
+			s.fork_cases = false;
+		else if (arg == "--metrics" && has_value)
+			s.metrics_path = argv[++i];
+		else if (arg == "--metrics-format" && has_value)
+			s.metrics_prometheus = std::string(argv[++i]) == "prometheus";
+		else {
+			std::cerr << "usage: benchmark [--sizes n,...] [--collections name,...] "
+			          << "[--distributions name,...] [--format csv|json] [--max-ops n] [--no-fork] "
+			          << "[--metrics path] [--metrics-format text|prometheus]" << std::endl;
+			return 1;
+		}
+	}
+	if (!s.metrics_path.empty()) {
+#ifndef COLLECTION_METRICS
+		std::cerr << "benchmark: --metrics needs a build with -DCOLLECTION_METRICS (make benchmark_metrics)"
+		          << std::endl;
+		return 1;
+#endif
+		s.fork_cases = false;
+	}
+
+	bool first_row = true;
+	if (s.json)
+		std::cout << "[\n";
+	else
+		std::cout << "collection,distribution,size,op,ops,ns_per_op,p50_ns,p90_ns,p99_ns,max_ns,peak_rss_kb"
+		          << std::endl;
+	for (const Entry& e : entries) {
+		if (!s.collections.empty() &&
+		    std::find(s.collections.begin(), s.collections.end(), e.name) == s.collections.end())
+			continue;
+		for (int d : s.distributions) {
+			for (long n : s.sizes) {
+				if (n < 1 || n > e.max_size[d])
+					continue;
+				std::vector<Result> results;
+				if (!run_entry(e, static_cast<Distribution>(d), n, s, results))
+					std::cerr << e.name << " " << distribution_names[d] << " " << n << " failed" << std::endl;
+				print_results(e, static_cast<Distribution>(d), n, results, s.json, first_row);
+			}
+		}
+	}
+	if (s.json)
+		std::cout << "\n]" << std::endl;
+	if (!s.metrics_path.empty() && !dump_collection_metrics(s.metrics_path.c_str(), s.metrics_prometheus)) {
+		std::cerr << "benchmark: cannot write " << s.metrics_path << std::endl;
+		return 1;
+	}
+	return 0;
+}
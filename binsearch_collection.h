@@ -1,22 +1,36 @@
 /*
 Greeley Lindberg
 10/10/19, hw5
-Description: Implementation of Collection using a binary search vector
+Description: Implementation of Collection using a binary search vector.
+Columnar picks the layout of the pairs (see kv_storage.h).
 */
 
 #ifndef BINSEARCH_COLLECTION_H
 #define BINSEARCH_COLLECTION_H
 
 #include <vector>
+#include <utility>
 #include "collection.h"
+#include "bulk_load.h"
+#include "kv_storage.h"
+#include "eytzinger.h"
+#include "instrumentation.h"
 
-template <typename K, typename V>
+template <typename K, typename V, bool Columnar = columnar_by_default<K,V>::value>
 class BinSearchCollection : public Collection <K,V> {
 public:
 
 // insert a key-value pair into the collection
 void insert(const K& key, const V& val);
 
+// insert a key-value pair, moving the key and value into the collection
+void insert(K&& key, V&& val);
+
+// insert a key-value pair with the key forwarded from key and the value
+// constructed in place from args
+template <typename KArg, typename... Args>
+void emplace(KArg&& key, Args&&... args);
+
 // remove a key-value pair from the collection
 void remove(const K& key);
 
@@ -32,98 +46,198 @@ void keys(std::vector <K>& keys) const;
 // return all of the keys in ascending (sorted) order
 void sort(std::vector <K>& keys) const;
 
+// keys() and sort() with the keys copied on pool
+void parallel_keys(std::vector <K>& keys, ThreadPool& pool) const;
+void parallel_sort(std::vector <K>& keys, ThreadPool& pool) const;
+
 // return the number of keys in collection
 int size() const;
 
+// call visitor on each key-value pair in ascending key order until it returns false
+void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+// call visitor on each key-value pair with k1 <= key <= k2 in ascending key order
+// until it returns false
+void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+// replace the contents with the key-value pairs in [begin, end) (linear
+// time when the keys are already ascending)
+template <typename Iter>
+void bulk_load(Iter begin, Iter end);
+
+// lay the keys out again in Eytzinger order, for faster find(), range
+// find and visit() while the collection is read only (call after loading;
+// any insert or remove drops it)
+void build_read_index();
+
+// return true while the Eytzinger read index is in use
+bool has_read_index() const;
+
 private:
 
 // helper function for binary search
 bool binsearch(const K& key, int& index) const;
 
-// vector storage
-std::vector <std::pair <K,V>> kv_list;
+// pairs in ascending key order (keys in their own array when Columnar,
+// so the search and range scans only read keys; see kv_storage.h)
+KVStorage<K,V,Columnar> kv_list;
+
+// Eytzinger copy of the keys (only while built)
+EytzingerIndex<K> read_index;
 
 };
 
 
-// This function returns true and sets index if key is found in
-// kv_list, and returns false and sets index to where key should go in
-// kv_list otherwise. If list is empty, index is unchanged.
-template <typename K, typename V>
-bool BinSearchCollection<K,V>::binsearch(const K& key, int& index) const {
-	if (kv_list.empty())
-		return false;
-	int low = 0;
-	int high = kv_list.size() - 1;
-	while (low <= high) {
-		index = (low + high) / 2;
-		if (key == kv_list[index].first)
-			return true;
-		else if (key < kv_list[index].first)
-			high = index - 1;
-		else if (key > kv_list[index].first) 
-			low = index + 1;
-	}
-	index = low;		// index = where key would go if it were in the list
-	return false;
+// This function returns true and sets index to the first pair with key
+// if key is found in kv_list, and returns false and sets index to where
+// key should go in kv_list otherwise.
+template <typename K, typename V, bool Columnar>
+bool BinSearchCollection<K,V,Columnar>::binsearch(const K& key, int& index) const {
+	COLLECTION_PROBES(binary_search_probes(kv_list.size()));
+	index = read_index.built() ? read_index.lower_bound(key) : kv_list.lower_bound(key);
+	return index < kv_list.size() && kv_list.key(index) == key;
 }
 
-template <typename K, typename V>
-void BinSearchCollection<K,V>::insert(const K& key, const V& val) {
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::insert(const K& key, const V& val) {
+	COLLECTION_OP("BinSearch", OP_INSERT);
 	int i = 0;
 	binsearch(key, i);
-	std::pair<K, V> p (key, val);
-	kv_list.insert(kv_list.begin() + i, p);
+	read_index.clear();
+	kv_list.emplace(i, key, val);
 }
 
-template <typename K, typename V>
-void BinSearchCollection<K,V>::remove(const K& key) {
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::insert(K&& key, V&& val) {
+	COLLECTION_OP("BinSearch", OP_INSERT);
 	int i = 0;
-	if (binsearch(key, i))
-		kv_list.erase(kv_list.begin() + i);
+	binsearch(key, i);
+	read_index.clear();
+	kv_list.emplace(i, std::move(key), std::move(val));
+}
+
+template <typename K, typename V, bool Columnar>
+template <typename KArg, typename... Args>
+void BinSearchCollection<K,V,Columnar>::emplace(KArg&& key, Args&&... args) {
+	COLLECTION_OP("BinSearch", OP_INSERT);
+	int i = 0;
+	binsearch(key, i);
+	read_index.clear();
+	kv_list.emplace(i, std::forward<KArg>(key), std::forward<Args>(args)...);
+}
+
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::remove(const K& key) {
+	COLLECTION_OP("BinSearch", OP_REMOVE);
+	int i = 0;
+	if (binsearch(key, i)) {
+		read_index.clear();
+		kv_list.erase(i);
+	}
 }
 
-template <typename K, typename V>
-bool BinSearchCollection<K,V>::find(const K& key, V& val) const {
+template <typename K, typename V, bool Columnar>
+bool BinSearchCollection<K,V,Columnar>::find(const K& key, V& val) const {
+	COLLECTION_OP("BinSearch", OP_FIND);
 	int i = 0;
 	if (binsearch(key, i)) {
-		val = kv_list[i].second;
+		val = kv_list.value(i);
 		return true;
 	}	
 	return false;
 }
 
-template <typename K, typename V>
-void BinSearchCollection<K,V>::find(const K& k1, const K& k2, std::vector <K>& keys) const {
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::find(const K& k1, const K& k2, std::vector <K>& keys) const {
+	COLLECTION_OP("BinSearch", OP_RANGE);
 	keys.clear();
-	int start = 0;
-	int end = 0;
-	binsearch(k1, start);
-	binsearch(k2, end);
-	if (start <= end && start < kv_list.size()) {
-		if (end == size())
-			end--;
-		for (int i = start; i <= end; i++)
-			keys.push_back(kv_list[i].first);
-	}
+	int i = 0;
+	binsearch(k1, i);
+	for (; i < kv_list.size() && kv_list.key(i) <= k2; i++)
+		keys.push_back(kv_list.key(i));
 }
 
-template <typename K, typename V>
-void BinSearchCollection<K,V>::keys(std::vector <K>& keys) const {
-	keys.clear();
-	unsigned int i = 0;
-	for(std::pair<K,V> p : kv_list) {
-		keys.push_back(kv_list[i].first);
-		i++;
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::keys(std::vector <K>& keys) const {
+	kv_list.keys(keys);
+}
+
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::sort(std::vector <K>& keys) const {
+	// kv_list is kept in key order
+	this->keys(keys);
+}
+
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::parallel_keys(std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || kv_list.size() < parallel_min_items) {
+		keys(ks);
+		return;
 	}
+	// each piece copies an equal run of the keys into place
+	size_t n = kv_list.size();
+	int pieces = parallel_pieces(pool);
+	ks.resize(n);
+	parallel_for(pool, pieces, [&](int p) {
+		for (size_t i = n * p / pieces; i < n * (p + 1) / pieces; i++)
+			ks[i] = kv_list.key(i);
+	});
 }
 
-template <typename K, typename V>
-void BinSearchCollection<K,V>::sort(std::vector <K>& keys) const {}
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::parallel_sort(std::vector <K>& ks, ThreadPool& pool) const {
+	parallel_keys(ks, pool);
+}
 
-template <typename K, typename V>
-int BinSearchCollection<K,V>::size() const {
+template <typename K, typename V, bool Columnar>
+int BinSearchCollection<K,V,Columnar>::size() const {
 	return kv_list.size();
 }
 
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	for (int i = 0; i < kv_list.size(); i++)
+		if (!visitor(kv_list.key(i), kv_list.value(i)))
+			return;
+}
+
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	int i = 0;
+	binsearch(k1, i);
+	for (; i < size() && kv_list.key(i) <= k2; i++)
+		if (!visitor(kv_list.key(i), kv_list.value(i)))
+			return;
+}
+
+template <typename K, typename V, bool Columnar>
+template <typename Iter>
+void BinSearchCollection<K,V,Columnar>::bulk_load(Iter begin, Iter end) {
+	read_index.clear();
+	if (!keys_ascending(begin, end)) {
+		std::vector<std::pair<K,V>> sorted;
+		sort_by_key(begin, end, sorted);
+		kv_list.clear();
+		kv_list.reserve(sorted.size());
+		for (std::pair<K,V>& p : sorted)
+			kv_list.emplace_back(std::move(p.first), std::move(p.second));
+		return;
+	}
+	// already in order, so fill the vector in one pass
+	kv_list.clear();
+	kv_list.reserve(std::distance(begin, end));
+	for (Iter it = begin; it != end; ++it)
+		kv_list.emplace_back(it->first, it->second);
+}
+
+template <typename K, typename V, bool Columnar>
+void BinSearchCollection<K,V,Columnar>::build_read_index() {
+	read_index.build(kv_list.size(), [this](int i) { return kv_list.key(i); });
+}
+
+template <typename K, typename V, bool Columnar>
+bool BinSearchCollection<K,V,Columnar>::has_read_index() const {
+	return read_index.built();
+}
+
 #endif
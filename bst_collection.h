@@ -9,10 +9,17 @@ Description: Implementation of Collection using a binary search tree.
 
 #include <vector>
 #include <algorithm>
+#include <utility>
+#include <type_traits>
 #include "collection.h"
+#include "bulk_load.h"
+#include "node_allocator.h"
+#include "tree_traversal.h"
+#include "tree_stats.h"
+#include "instrumentation.h"
 
 
-template <typename K, typename V>
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool>
 class BSTCollection : public Collection<K,V> {
 public:
 
@@ -20,10 +27,16 @@ public:
 	BSTCollection();
 
 	// copy a linked list
-	BSTCollection(const BSTCollection<K,V>& rhs);
+	BSTCollection(const BSTCollection<K,V,NodeAlloc>& rhs);
 
 	// assign a linked list
-	BSTCollection<K,V>& operator =(const BSTCollection<K,V>& rhs);
+	BSTCollection<K,V,NodeAlloc>& operator =(const BSTCollection<K,V,NodeAlloc>& rhs);
+
+	// move a search tree (rhs is left empty)
+	BSTCollection(BSTCollection<K,V,NodeAlloc>&& rhs) noexcept;
+
+	// move assign a search tree (rhs is left empty)
+	BSTCollection<K,V,NodeAlloc>& operator =(BSTCollection<K,V,NodeAlloc>&& rhs) noexcept;
 
 	// delete a linked list
 	~BSTCollection();
@@ -31,6 +44,14 @@ public:
 	// insert a key -value pair into the collection
 	void insert(const K& key, const V& val);
 
+	// insert a key-value pair, moving the key and value into the collection
+	void insert(K&& key, V&& val);
+
+	// insert a key-value pair with the key forwarded from key and the value
+	// constructed in place from args
+	template <typename KArg, typename... Args>
+	void emplace(KArg&& key, Args&&... args);
+
 	// remove a key -value pair from the collection
 	void remove(const K& key);
 
@@ -40,22 +61,56 @@ public:
 	// find the keys associated with the range
 	void find(const K& k1, const K& k2, std::vector <K>& keys) const;
 
+	// find the values of keys[0..n-1], walking a group of the searches down
+	// the tree together
+	void find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const;
+
 	// return all keys in the collection
 	void keys(std::vector <K>& keys) const;
 
 	// return collection keys in sorted order
 	void sort(std::vector <K>& keys) const;
 
+	// keys(), sort() and find(k1, k2, keys) with the subtrees walked on pool
+	void parallel_keys(std::vector <K>& keys, ThreadPool& pool) const;
+	void parallel_sort(std::vector <K>& keys, ThreadPool& pool) const;
+	void parallel_find(const K& k1, const K& k2, std::vector <K>& keys, ThreadPool& pool) const;
+
 	// return the number of keys in collection
 	int size() const;
 
-	// return the height of the tree
+	// call visitor on each key-value pair in ascending key order until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2 in ascending key order
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// replace the contents with the key-value pairs in [begin, end) (linear
+	// time when the keys are already ascending)
+	template <typename Iter>
+	void bulk_load(Iter begin, Iter end);
+
+	// return the height of the tree (walks every node; stats() has the
+	// cheap max_depth)
 	int height() const;
 
+	// return the structural stats, in O(1) time
+	TreeStats stats() const;
+
+	// restart the stats that count since the last reset
+	void reset_stats();
+
 private:
 
 	// binary search tree node structure
 	struct Node {
+		// construct the key from k and the value from args
+		template <typename KArg, typename... Args>
+		Node(std::piecewise_construct_t, KArg&& k, Args&&... args): key(std::forward<KArg>(k)),
+			value(std::forward<Args>(args)...) {}
+		Node() {}
+
 		K key;
 		V value;
 		Node* left;
@@ -68,175 +123,215 @@ private:
 	// number of k-v pairs in the collection
 	int collection_size;
 
-	// helper to recursively empty search tree
+	// allocator for the tree nodes
+	NodeAlloc<Node> nodes;
+
+	// structural stats (nodes is filled in by stats())
+	TreeStats tree_stats;
+
+	// helper to empty the search tree
+	void make_empty();
+
+	// helper to empty search tree (iteratively)
 	void make_empty(Node* subtree_root);
 
-	// helper to recursively build sorted list of keys
+	// helper to copy subtree node for node (iteratively)
+	Node* copy(const Node* subtree_root);
+
+	// helper to build sorted list of keys (iteratively)
 	void inorder(const Node* subtree, std::vector <K>& keys) const;
 
-	// helper to recursively build sorted list of keys
+	// helper to build list of keys in preorder (iteratively)
 	void preorder(const Node* subtree, std::vector <K>& keys) const;
 
-	// helper to recursively find range of keys
+	// helper to find range of keys in ascending order (iteratively)
 	void range_search(const Node* subtree, const K& k1, const K& k2,
 	std::vector <K>& keys) const;
 
+	// helper to visit subtree in order (returns false once the visitor
+	// stops)
+	bool inorder(const Node* subtree, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// helper to visit the keys of subtree in range in order (returns
+	// false once the visitor stops)
+	bool range_search(const Node* subtree, const K& k1, const K& k2,
+	const std::function<bool(const K&, const V&)>& visitor) const;
+
 	// return the height of the tree rooted at subtree_root
 	int height(const Node* subtree_root) const;
 
+	// helper to build a balanced subtree from the next n pairs at it
+	template <typename Iter>
+	Node* build(Iter& it, int n);
+
 };
 
 
-template <typename K, typename V>
-BSTCollection<K,V>::BSTCollection(): collection_size (0), root(nullptr){}
+template <typename K, typename V, template <typename> class NodeAlloc>
+BSTCollection<K,V,NodeAlloc>::BSTCollection(): collection_size (0), root(nullptr), tree_stats(empty_tree_stats()){}
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::make_empty(Node* subtree_root) {
-	if (!subtree_root)
-		return;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::make_empty(Node* subtree_root) {
+	destroy_nodes(subtree_root, [this](Node* ptr) { nodes.destroy(ptr); });
+}
 
-	make_empty(subtree_root->left);
-	make_empty(subtree_root->right);
-	delete subtree_root;
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::make_empty() {
+	// a pool frees all the nodes at once, so they only need to be
+	// visited if they have destructors to run
+	if (!NodeAlloc<Node>::bulk_release || !std::is_trivially_destructible<Node>::value)
+		make_empty(root);
+	nodes.release();
+	root = nullptr;
+	collection_size = 0;
+	tree_stats.black_height = 0;
 }
 
 
-template <typename K, typename V>
-BSTCollection<K,V>::~BSTCollection() {
-	make_empty(root);
+template <typename K, typename V, template <typename> class NodeAlloc>
+BSTCollection<K,V,NodeAlloc>::~BSTCollection() {
+	make_empty();
 }
 
 
-template <typename K, typename V>
-BSTCollection<K,V>::BSTCollection(const BSTCollection<K,V>& rhs): collection_size (0), root(nullptr) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+BSTCollection<K,V,NodeAlloc>::BSTCollection(const BSTCollection<K,V,NodeAlloc>& rhs): collection_size (0), root(nullptr), tree_stats(empty_tree_stats()) {
 	*this = rhs;
 }
 
 
-template <typename K, typename V>
-BSTCollection<K,V>& BSTCollection<K,V>::operator =(const BSTCollection<K,V>& rhs) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+BSTCollection<K,V,NodeAlloc>& BSTCollection<K,V,NodeAlloc>::operator =(const BSTCollection<K,V,NodeAlloc>& rhs) {
 	if (this == &rhs)
 		return *this;
 	// delete current
-	make_empty(root);
-	// build tree
-	std::vector <K> ks;
-	preorder(rhs.root, ks);
-	V val;
-	for (int i = 0; i < ks.size(); i++) {
-		rhs.find(ks[i], val);
-		insert(ks[i], val);
-	}
+	make_empty();
+	// copy node for node, keeping rhs's shape, instead of reinserting
+	root = copy(rhs.root);
+	collection_size = rhs.collection_size;
+	tree_stats = rhs.tree_stats;
 
 	return *this;
 }
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::insert(const K& key, const V& val) {
-	Node* ptr = new Node;
-	ptr->key = key;
-	ptr->value = val;
+template <typename K, typename V, template <typename> class NodeAlloc>
+BSTCollection<K,V,NodeAlloc>::BSTCollection(BSTCollection<K,V,NodeAlloc>&& rhs) noexcept: root(nullptr), collection_size (0), tree_stats(empty_tree_stats()) {
+	*this = std::move(rhs);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BSTCollection<K,V,NodeAlloc>& BSTCollection<K,V,NodeAlloc>::operator =(BSTCollection<K,V,NodeAlloc>&& rhs) noexcept {
+	if (this == &rhs)
+		return *this;
+	// take over rhs's nodes and leave it with this (now empty) tree
+	make_empty();
+	std::swap(root, rhs.root);
+	std::swap(collection_size, rhs.collection_size);
+	std::swap(tree_stats, rhs.tree_stats);
+	nodes.swap(rhs.nodes);
+
+	return *this;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename BSTCollection<K,V,NodeAlloc>::Node* BSTCollection<K,V,NodeAlloc>::copy(const Node* subtree_root) {
+	return clone_nodes(subtree_root, [this]() { return nodes.create(); });
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::insert(const K& key, const V& val) {
+	emplace(key, val);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::insert(K&& key, V&& val) {
+	emplace(std::move(key), std::move(val));
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename KArg, typename... Args>
+void BSTCollection<K,V,NodeAlloc>::emplace(KArg&& key, Args&&... args) {
+	COLLECTION_OP("BST", OP_INSERT);
+	Node* ptr = nodes.create(std::piecewise_construct, std::forward<KArg>(key), std::forward<Args>(args)...);
 	ptr->left = nullptr;
 	ptr->right = nullptr;
 	collection_size++;
 
-	if (!root)
+	if (!root) {
 		root = ptr;
+		tree_stats.max_depth = std::max(tree_stats.max_depth, 1);
+	}
 	else {
 		Node* curr = root;
-		while (curr)
+		int depth = 1;
+		while (curr) {
+			depth++;
 			if (ptr->key < curr->key) 
 				if (!curr->left) {
 					curr->left = ptr;
-					return;
+					break;
 				}
 				else
 					curr = curr->left;
 			else
 				if (!curr->right) {
 					curr->right = ptr;
-					return;
+					break;
 				}
 				else
 					curr = curr->right;
+		}
+		tree_stats.max_depth = std::max(tree_stats.max_depth, depth);
+		COLLECTION_PROBES(depth - 1);
 	}
 
 }
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::remove(const K& key) {
-	if (!subtree_root)
-		return subtree_root;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::remove(const K& key) {
+	COLLECTION_OP("BST", OP_REMOVE);
+	// find the link (root or a child pointer) that points at the key's node
+	Node** link = &root;
+	while (*link && !(key == (*link)->key)) {
+		COLLECTION_PROBES(1);
+		link = key < (*link)->key ? &(*link)->left : &(*link)->right;
+	}
+	Node* target = *link;
+	if (!target)
+		return;
 
-	if (subtree_root && key < subtree_root->key) 
-		subtree_root->left = remove(key, subtree_root->left);
-	else if (subtree_root && key > subtree_root->key)
-		subtree_root->right = remove(key, subtree_root->right);
-	else if (subtree_root && key == subtree_root->key) {
-		if (!subtree_root->left && !subtree_root->right) {
-			delete subtree_root;
-			subtree_root = nullptr;
-		}
-		else if (!subtree_root->left || !subtree_root->right) {
-			Node* temp;
-			if (subtree_root->left) {
-				temp = subtree_root->left;
-				subtree_root->key = subtree_root->left->key;
-				subtree_root->value = subtree_root->left->value;
-				subtree_root->right = subtree_root->left->right;
-				subtree_root->left = subtree_root->left->left;
-			}
-			else {
-				temp = subtree_root->right;
-				subtree_root->key = subtree_root->right->key;
-				subtree_root->value = subtree_root->right->value;
-				subtree_root->left = subtree_root->right->left;
-				subtree_root->right = subtree_root->right->right;
-			}
-			delete temp;
-			temp = nullptr;
-		}
-		else {
-			Node* successor = subtree_root->right;
-			Node* parent = successor;
-			while (successor->left) {
-				parent = successor;
-				successor = successor->left;
-			}
-			subtree_root->key = successor->key;
-			subtree_root->value = successor->value;
-			Node* temp;
-			if (successor->right) {
-				temp = successor->right;
-				successor->key = successor->right->key;
-				successor->value = successor->right->value;
-				successor->left = successor->right->left;
-				successor->right = successor->right->right;
-				delete temp;
-				temp = nullptr;
-			}
-			else {
-				if (successor->key == subtree_root->right->key)
-					subtree_root->right = nullptr;
-				else
-					parent->left = nullptr;
-				delete successor;
-				successor = nullptr;
-			}
-			
-		}
+	if (target->left && target->right) {
+		// unlink the successor (leftmost node of the right subtree) and
+		// put it in target's place
+		Node** successor_link = &target->right;
+		while ((*successor_link)->left)
+			successor_link = &(*successor_link)->left;
+		Node* successor = *successor_link;
+		*successor_link = successor->right;
+		successor->left = target->left;
+		successor->right = target->right;
+		*link = successor;
 	}
-	return subtree_root;
+	else
+		*link = target->left ? target->left : target->right;
+	nodes.destroy(target);
+	collection_size--;
 }
 
 
-template <typename K, typename V>
-bool BSTCollection<K,V>::find(const K& key, V& val) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool BSTCollection<K,V,NodeAlloc>::find(const K& key, V& val) const {
+	COLLECTION_OP("BST", OP_FIND);
 	Node* curr = root;
-	while (curr)
+	while (curr) {
+		COLLECTION_PROBES(1);
 		if (key == curr->key) {
 			val = curr->value;
 			return true;
@@ -245,103 +340,191 @@ bool BSTCollection<K,V>::find(const K& key, V& val) const {
 			curr = curr->left;
 		else
 			curr = curr->right;
+	}
 
 	return false;
 }
 
 
-template <typename K, typename V> void
-BSTCollection<K,V>::range_search(const Node* subtree, const K& k1, const K& k2, std::vector <K>& ks) const {
-	if (!subtree)
-		return;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::find_batch(const K* ks, int n, V* vals, std::vector<bool>& found) const {
+	found.assign(n, false);
+	find_nodes_batch(root, ks, n, batch_group_size, [&](int i, const Node* node) {
+		vals[i] = node->value;
+		found[i] = true;
+	});
+}
 
-	if (subtree->key < k1)
-		range_search(subtree->right, k1, k2, ks);
-	else if (subtree->key >= k1 && subtree->key <= k2) {
-		ks.push_back(subtree->key);
-		range_search(subtree->left, k1, k2, ks);
-		range_search(subtree->right, k1, k2, ks);
-	}
-	else
-		range_search(subtree->left, k1, k2, ks);
+
+template <typename K, typename V, template <typename> class NodeAlloc> void
+BSTCollection<K,V,NodeAlloc>::range_search(const Node* subtree, const K& k1, const K& k2, std::vector <K>& ks) const {
+	inorder_nodes(subtree, &k1, &k2, [&ks](const Node* ptr) {
+		ks.push_back(ptr->key);
+		return true;
+	});
 }
 
 
-template <typename K, typename V> void
-BSTCollection<K,V>::find(const K& k1, const K& k2, std::vector <K>& ks) const {
-	// defer to the range search (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc> void
+BSTCollection<K,V,NodeAlloc>::find(const K& k1, const K& k2, std::vector <K>& ks) const {
+	COLLECTION_OP("BST", OP_RANGE);
+	// defer to the range search (iterative) helper function
 	ks.clear();
 	range_search(root, k1, k2, ks);
+	COLLECTION_PROBES(ks.size());
 }
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::inorder(const Node* subtree, std::vector <K>& ks) const {
-	if (!subtree)
-		return;
-
-	inorder(subtree->left, ks);
-	ks.push_back(subtree->key);
-	inorder(subtree->right, ks);
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::inorder(const Node* subtree, std::vector <K>& ks) const {
+	inorder_nodes(subtree, (const K*) nullptr, (const K*) nullptr, [&ks](const Node* ptr) {
+		ks.push_back(ptr->key);
+		return true;
+	});
 }
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::preorder(const Node* subtree, std::vector <K>& ks) const {
-	if (!subtree)
-		return;
-
-	ks.push_back(subtree->key);
-	preorder(subtree->left, ks);
-	preorder(subtree->right, ks);
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::preorder(const Node* subtree, std::vector <K>& ks) const {
+	preorder_nodes(subtree, [&ks](const Node* ptr) { ks.push_back(ptr->key); });
 }
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::keys(std::vector <K>& ks) const {
-	// defer to the inorder (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::keys(std::vector <K>& ks) const {
+	// defer to the inorder (iterative) helper function
 	ks.clear();
 	inorder(root, ks);
 }
 
 
-template <typename K, typename V>
-void BSTCollection<K,V>::sort(std::vector <K>& ks) const {
-	// defer to the inorder (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::sort(std::vector <K>& ks) const {
+	// defer to the inorder (iterative) helper function
 	ks.clear();
 	inorder(root, ks);
-	std::sort(ks.begin(), ks.end());
 }
 
 
-template <typename K, typename V>
-int BSTCollection<K,V>::size() const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::parallel_keys(std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		keys(ks);
+		return;
+	}
+	inorder_keys_in_parallel(pool, root, (const K*) nullptr, (const K*) nullptr, ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::parallel_sort(std::vector <K>& ks, ThreadPool& pool) const {
+	// the in-order walk is already sorted
+	parallel_keys(ks, pool);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::parallel_find(const K& k1, const K& k2, std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		find(k1, k2, ks);
+		return;
+	}
+	inorder_keys_in_parallel(pool, root, &k1, &k2, ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int BSTCollection<K,V,NodeAlloc>::size() const {
 	return collection_size;
 }
 
 
-template <typename K, typename V>
-int BSTCollection<K,V>::height(const Node* subtree_root) const {
-	int left_height;
-	int right_height;
+template <typename K, typename V, template <typename> class NodeAlloc>
+int BSTCollection<K,V,NodeAlloc>::height(const Node* subtree_root) const {
+	return tree_height(subtree_root);
+}
+
 
-	if (!subtree_root)
-		return 0;
+template <typename K, typename V, template <typename> class NodeAlloc>
+TreeStats BSTCollection<K,V,NodeAlloc>::stats() const {
+	TreeStats current = tree_stats;
+	current.nodes = collection_size;
+	return current;
+}
 
-	left_height = height(subtree_root->left);
-	right_height = height(subtree_root->right);
 
-	if (left_height > right_height)
-		return left_height + 1;
-	else
-		return right_height + 1;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::reset_stats() {
+	reset_counters(tree_stats);
 }
 
 
-template <typename K, typename V>
-int BSTCollection<K,V>::height() const {
-	// defer to the height (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc>
+int BSTCollection<K,V,NodeAlloc>::height() const {
+	// defer to the height (iterative) helper function
 	return height(root);
 }
 
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool BSTCollection<K,V,NodeAlloc>::inorder(const Node* subtree, const std::function<bool(const K&, const V&)>& visitor) const {
+	return inorder_nodes(subtree, (const K*) nullptr, (const K*) nullptr, [&visitor](const Node* ptr) {
+		return visitor(ptr->key, ptr->value);
+	});
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool BSTCollection<K,V,NodeAlloc>::range_search(const Node* subtree, const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	return inorder_nodes(subtree, &k1, &k2, [&visitor](const Node* ptr) {
+		return visitor(ptr->key, ptr->value);
+	});
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	// defer to the inorder (iterative) helper function
+	inorder(root, visitor);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BSTCollection<K,V,NodeAlloc>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	// defer to the range search (iterative) helper function
+	range_search(root, k1, k2, visitor);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Iter>
+void BSTCollection<K,V,NodeAlloc>::bulk_load(Iter begin, Iter end) {
+	if (!keys_ascending(begin, end)) {
+		std::vector<std::pair<K,V>> sorted;
+		sort_by_key(begin, end, sorted);
+		bulk_load(sorted.begin(), sorted.end());
+		return;
+	}
+	make_empty();
+	int n = std::distance(begin, end);
+	root = build(begin, n);
+	collection_size = n;
+	tree_stats.max_depth = std::max(tree_stats.max_depth, balanced_height(n));
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Iter>
+typename BSTCollection<K,V,NodeAlloc>::Node* BSTCollection<K,V,NodeAlloc>::build(Iter& it, int n) {
+	if (n == 0)
+		return nullptr;
+	// build the left half first so the pairs are used in order
+	Node* left = build(it, (n - 1) / 2);
+	Node* ptr = nodes.create();
+	ptr->key = it->first;
+	ptr->value = it->second;
+	++it;
+	ptr->left = left;
+	ptr->right = build(it, n - 1 - (n - 1) / 2);
+	return ptr;
+}
+
 #endif
@@ -0,0 +1,845 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Implementation of Collection using a B+ tree. Each node keeps
+its keys in one contiguous array sized to a few cache lines, so a lookup
+touches a handful of nodes instead of one node per level of a binary tree.
+Values are only stored in the leaves, and the leaves are linked in key
+order, so range finds and keys() are a sequential scan over the leaves.
+*/
+
+#ifndef BTREE_COLLECTION_H
+#define BTREE_COLLECTION_H
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "collection.h"
+#include "bulk_load.h"
+#include "node_allocator.h"
+#include "instrumentation.h"
+
+
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool>
+class BTreeCollection : public Collection<K,V> {
+public:
+
+	// create an empty tree
+	BTreeCollection();
+
+	// copy a tree
+	BTreeCollection(const BTreeCollection<K,V,NodeAlloc>& rhs);
+
+	// assign a tree
+	BTreeCollection<K,V,NodeAlloc>& operator =(const BTreeCollection<K,V,NodeAlloc>& rhs);
+
+	// move a tree (rhs is left empty)
+	BTreeCollection(BTreeCollection<K,V,NodeAlloc>&& rhs) noexcept;
+
+	// move assign a tree (rhs is left empty)
+	BTreeCollection<K,V,NodeAlloc>& operator =(BTreeCollection<K,V,NodeAlloc>&& rhs) noexcept;
+
+	// delete a tree
+	~BTreeCollection();
+
+	// insert a key-value pair into the collection (replaces the value
+	// if the key is already present)
+	void insert(const K& key, const V& val);
+
+	// remove a key-value pair from the collection
+	void remove(const K& key);
+
+	// find the value associated with the key
+	bool find(const K& key, V& val) const;
+
+	// find the keys associated with the range
+	void find(const K& k1, const K& k2, std::vector <K>& keys) const;
+
+	// find the values of keys[0..n-1], moving a group of the searches down
+	// a level at a time and prefetching the next level's nodes
+	void find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const;
+
+	// return all keys in the collection
+	void keys(std::vector <K>& keys) const;
+
+	// return collection keys in sorted order
+	void sort(std::vector <K>& keys) const;
+
+	// keys(), sort() and find(k1, k2, keys) with runs of leaves scanned on pool
+	void parallel_keys(std::vector <K>& keys, ThreadPool& pool) const;
+	void parallel_sort(std::vector <K>& keys, ThreadPool& pool) const;
+	void parallel_find(const K& k1, const K& k2, std::vector <K>& keys, ThreadPool& pool) const;
+
+	// return the number of keys in collection
+	int size() const;
+
+	// call visitor on each key-value pair in ascending key order until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2 in ascending key order
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// replace the contents with the key-value pairs in [begin, end) (linear
+	// time when the keys are already ascending)
+	template <typename Iter>
+	void bulk_load(Iter begin, Iter end);
+
+	// return the height of the tree
+	int height() const;
+
+private:
+
+	// most keys in a node (enough to fill four 64 byte cache lines)
+	static const int max_keys = 256 / sizeof(K) < 8 ? 8 : 256 / sizeof(K);
+
+	// fewest keys in a node other than the root
+	static const int min_keys = max_keys / 2;
+
+	// tree node structure (keys[0..count-1] in ascending order)
+	struct Node {
+		bool is_leaf;
+		int count;
+		K keys[max_keys];
+	};
+
+	// leaf node with the values and links to the neighboring leaves
+	struct Leaf : Node {
+		V values[max_keys];
+		Leaf* prev;
+		Leaf* next;
+	};
+
+	// inner node: children[i] holds the keys < keys[i] and
+	// children[i+1] the keys >= keys[i]
+	struct Inner : Node {
+		Node* children[max_keys + 1];
+	};
+
+	// root node of the tree
+	Node* root;
+
+	// number of k-v pairs in the collection
+	int collection_size;
+
+	// allocators for the leaf and inner nodes
+	NodeAlloc<Leaf> leaves;
+	NodeAlloc<Inner> inners;
+
+	// helper to prefetch the count and keys of a node
+	static void prefetch(const Node* node);
+
+	// helpers to create an empty leaf or inner node
+	Leaf* new_leaf();
+	Inner* new_inner();
+
+	// helper to empty the tree
+	void make_empty();
+
+	// helper to recursively empty subtree
+	void make_empty(Node* subtree_root);
+
+	// helper to recursively copy subtree (prev is the last leaf copied)
+	Node* copy(const Node* subtree_root, Leaf*& prev);
+
+	// return the leaf that would hold key
+	const Leaf* find_leaf(const K& key) const;
+
+	// helper to set keys to the keys (limited to k1 <= key <= k2 when k1
+	// and k2 are set) by splitting the leaves into runs under the subtrees
+	// of one level and scanning the runs on pool
+	void scan_in_parallel(const K* k1, const K* k2, std::vector <K>& keys, ThreadPool& pool) const;
+
+	// recursive helper to insert into subtree; if the node had to split
+	// return the new right node and set split_key to its smallest key
+	Node* insert(Node* subtree_root, const K& key, const V& val, K& split_key);
+
+	// recursive helper to remove key from subtree (returns true if found)
+	bool remove(Node* subtree_root, const K& key);
+
+	// helper to refill child i of parent after it drops below min_keys
+	void fix_underflow(Inner* parent, int i);
+
+	// helper to merge child i+1 of parent into child i
+	void merge(Inner* parent, int i);
+
+	// helper to build the leaves from n ascending pairs and return them
+	// with their smallest keys
+	template <typename Iter>
+	void build_leaves(Iter it, int n, std::vector<std::pair<Node*,K>>& level);
+
+	// helper to build the parents of level and replace level with them
+	void build_level(std::vector<std::pair<Node*,K>>& level);
+};
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BTreeCollection<K,V,NodeAlloc>::BTreeCollection(): root(nullptr), collection_size(0) {}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename BTreeCollection<K,V,NodeAlloc>::Leaf* BTreeCollection<K,V,NodeAlloc>::new_leaf() {
+	Leaf* ptr = leaves.create();
+	ptr->is_leaf = true;
+	ptr->count = 0;
+	ptr->prev = nullptr;
+	ptr->next = nullptr;
+	return ptr;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename BTreeCollection<K,V,NodeAlloc>::Inner* BTreeCollection<K,V,NodeAlloc>::new_inner() {
+	Inner* ptr = inners.create();
+	ptr->is_leaf = false;
+	ptr->count = 0;
+	return ptr;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::make_empty(Node* subtree_root) {
+	if (!subtree_root)
+		return;
+	if (subtree_root->is_leaf)
+		leaves.destroy(static_cast<Leaf*>(subtree_root));
+	else {
+		Inner* inner = static_cast<Inner*>(subtree_root);
+		for (int i = 0; i <= inner->count; i++)
+			make_empty(inner->children[i]);
+		inners.destroy(inner);
+	}
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::make_empty() {
+	// a pool frees all the nodes at once, so they only need to be
+	// visited if they have destructors to run
+	if (!NodeAlloc<Leaf>::bulk_release || !std::is_trivially_destructible<Leaf>::value ||
+	    !std::is_trivially_destructible<Inner>::value)
+		make_empty(root);
+	leaves.release();
+	inners.release();
+	root = nullptr;
+	collection_size = 0;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BTreeCollection<K,V,NodeAlloc>::~BTreeCollection() {
+	make_empty();
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BTreeCollection<K,V,NodeAlloc>::BTreeCollection(const BTreeCollection<K,V,NodeAlloc>& rhs): root(nullptr), collection_size(0) {
+	*this = rhs;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BTreeCollection<K,V,NodeAlloc>& BTreeCollection<K,V,NodeAlloc>::operator =(const BTreeCollection<K,V,NodeAlloc>& rhs) {
+	if (this == &rhs)
+		return *this;
+	// delete current
+	make_empty();
+	// copy node for node
+	Leaf* prev = nullptr;
+	root = copy(rhs.root, prev);
+	collection_size = rhs.collection_size;
+	return *this;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BTreeCollection<K,V,NodeAlloc>::BTreeCollection(BTreeCollection<K,V,NodeAlloc>&& rhs) noexcept: root(nullptr), collection_size(0) {
+	*this = std::move(rhs);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+BTreeCollection<K,V,NodeAlloc>& BTreeCollection<K,V,NodeAlloc>::operator =(BTreeCollection<K,V,NodeAlloc>&& rhs) noexcept {
+	if (this == &rhs)
+		return *this;
+	// take over rhs's nodes and leave it with this (now empty) tree
+	make_empty();
+	std::swap(root, rhs.root);
+	std::swap(collection_size, rhs.collection_size);
+	leaves.swap(rhs.leaves);
+	inners.swap(rhs.inners);
+	return *this;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename BTreeCollection<K,V,NodeAlloc>::Node*
+BTreeCollection<K,V,NodeAlloc>::copy(const Node* subtree_root, Leaf*& prev) {
+	if (!subtree_root)
+		return nullptr;
+	if (subtree_root->is_leaf) {
+		const Leaf* leaf = static_cast<const Leaf*>(subtree_root);
+		Leaf* ptr = new_leaf();
+		ptr->count = leaf->count;
+		std::copy(leaf->keys, leaf->keys + leaf->count, ptr->keys);
+		std::copy(leaf->values, leaf->values + leaf->count, ptr->values);
+		// leaves are copied left to right, so link to the previous one
+		ptr->prev = prev;
+		if (prev)
+			prev->next = ptr;
+		prev = ptr;
+		return ptr;
+	}
+	const Inner* inner = static_cast<const Inner*>(subtree_root);
+	Inner* ptr = new_inner();
+	ptr->count = inner->count;
+	std::copy(inner->keys, inner->keys + inner->count, ptr->keys);
+	for (int i = 0; i <= inner->count; i++)
+		ptr->children[i] = copy(inner->children[i], prev);
+	return ptr;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::prefetch(const Node* node) {
+	const char* bytes = reinterpret_cast<const char*>(node);
+	for (size_t offset = 0; offset < sizeof(Node); offset += 64)
+		__builtin_prefetch(bytes + offset);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+const typename BTreeCollection<K,V,NodeAlloc>::Leaf* BTreeCollection<K,V,NodeAlloc>::find_leaf(const K& key) const {
+	const Node* curr = root;
+	if (!curr)
+		return nullptr;
+	while (!curr->is_leaf) {
+		const Inner* inner = static_cast<const Inner*>(curr);
+		COLLECTION_PROBES(binary_search_probes(inner->count));
+		int i = std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys;
+		curr = inner->children[i];
+	}
+	return static_cast<const Leaf*>(curr);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename BTreeCollection<K,V,NodeAlloc>::Node*
+BTreeCollection<K,V,NodeAlloc>::insert(Node* subtree_root, const K& key, const V& val, K& split_key) {
+	if (subtree_root->is_leaf) {
+		Leaf* leaf = static_cast<Leaf*>(subtree_root);
+		COLLECTION_PROBES(binary_search_probes(leaf->count));
+		int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+		if (i < leaf->count && leaf->keys[i] == key) {
+			leaf->values[i] = val;
+			return nullptr;
+		}
+		collection_size++;
+		Leaf* target = leaf;
+		Leaf* right = nullptr;
+		if (leaf->count == max_keys) {
+			// split: the left leaf keeps (max_keys + 1) / 2 of the keys
+			// once the new one is in
+			int left_count = (max_keys + 1) / 2;
+			bool into_left = i < left_count;
+			if (into_left)
+				left_count--;
+			right = new_leaf();
+			right->count = leaf->count - left_count;
+			std::move(leaf->keys + left_count, leaf->keys + leaf->count, right->keys);
+			std::move(leaf->values + left_count, leaf->values + leaf->count, right->values);
+			leaf->count = left_count;
+			right->next = leaf->next;
+			if (right->next)
+				right->next->prev = right;
+			right->prev = leaf;
+			leaf->next = right;
+			if (!into_left) {
+				target = right;
+				i -= left_count;
+			}
+		}
+		std::move_backward(target->keys + i, target->keys + target->count, target->keys + target->count + 1);
+		std::move_backward(target->values + i, target->values + target->count, target->values + target->count + 1);
+		target->keys[i] = key;
+		target->values[i] = val;
+		target->count++;
+		if (right)
+			split_key = right->keys[0];
+		return right;
+	}
+
+	Inner* inner = static_cast<Inner*>(subtree_root);
+	COLLECTION_PROBES(binary_search_probes(inner->count));
+	int i = std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys;
+	K child_key;
+	Node* child = insert(inner->children[i], key, val, child_key);
+	if (!child)
+		return nullptr;
+	if (inner->count < max_keys) {
+		std::move_backward(inner->keys + i, inner->keys + inner->count, inner->keys + inner->count + 1);
+		std::move_backward(inner->children + i + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+		inner->keys[i] = child_key;
+		inner->children[i + 1] = child;
+		inner->count++;
+		return nullptr;
+	}
+	// split: line up all max_keys + 1 keys, keep the lower half, pass the
+	// middle key up and move the upper half to a new node
+	K all_keys[max_keys + 1];
+	Node* all_children[max_keys + 2];
+	std::move(inner->keys, inner->keys + i, all_keys);
+	all_keys[i] = child_key;
+	std::move(inner->keys + i, inner->keys + max_keys, all_keys + i + 1);
+	std::copy(inner->children, inner->children + i + 1, all_children);
+	all_children[i + 1] = child;
+	std::copy(inner->children + i + 1, inner->children + max_keys + 1, all_children + i + 2);
+	int mid = (max_keys + 1) / 2;
+	Inner* right = new_inner();
+	inner->count = mid;
+	std::move(all_keys, all_keys + mid, inner->keys);
+	std::copy(all_children, all_children + mid + 1, inner->children);
+	right->count = max_keys - mid;
+	std::move(all_keys + mid + 1, all_keys + max_keys + 1, right->keys);
+	std::copy(all_children + mid + 1, all_children + max_keys + 2, right->children);
+	split_key = all_keys[mid];
+	return right;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::insert(const K& key, const V& val) {
+	COLLECTION_OP("BTree", OP_INSERT);
+	if (!root)
+		root = new_leaf();
+	K split_key;
+	Node* right = insert(root, key, val, split_key);
+	// the root split, so the tree grows a level
+	if (right) {
+		Inner* ptr = new_inner();
+		ptr->count = 1;
+		ptr->keys[0] = split_key;
+		ptr->children[0] = root;
+		ptr->children[1] = right;
+		root = ptr;
+	}
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool BTreeCollection<K,V,NodeAlloc>::remove(Node* subtree_root, const K& key) {
+	if (subtree_root->is_leaf) {
+		Leaf* leaf = static_cast<Leaf*>(subtree_root);
+		COLLECTION_PROBES(binary_search_probes(leaf->count));
+		int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+		if (i == leaf->count || !(leaf->keys[i] == key))
+			return false;
+		std::move(leaf->keys + i + 1, leaf->keys + leaf->count, leaf->keys + i);
+		std::move(leaf->values + i + 1, leaf->values + leaf->count, leaf->values + i);
+		leaf->count--;
+		return true;
+	}
+	// separator keys only route searches, so they can be left alone even
+	// when the key they were copied from is removed
+	Inner* inner = static_cast<Inner*>(subtree_root);
+	COLLECTION_PROBES(binary_search_probes(inner->count));
+	int i = std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys;
+	if (!remove(inner->children[i], key))
+		return false;
+	if (inner->children[i]->count < min_keys)
+		fix_underflow(inner, i);
+	return true;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::fix_underflow(Inner* parent, int i) {
+	Node* child = parent->children[i];
+	Node* left = i > 0 ? parent->children[i - 1] : nullptr;
+	Node* right = i < parent->count ? parent->children[i + 1] : nullptr;
+
+	// borrow the largest key of the left sibling
+	if (left && left->count > min_keys) {
+		std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+		if (child->is_leaf) {
+			Leaf* c = static_cast<Leaf*>(child);
+			Leaf* l = static_cast<Leaf*>(left);
+			std::move_backward(c->values, c->values + c->count, c->values + c->count + 1);
+			c->keys[0] = l->keys[l->count - 1];
+			c->values[0] = l->values[l->count - 1];
+			parent->keys[i - 1] = c->keys[0];
+		}
+		else {
+			Inner* c = static_cast<Inner*>(child);
+			Inner* l = static_cast<Inner*>(left);
+			std::copy_backward(c->children, c->children + c->count + 1, c->children + c->count + 2);
+			c->keys[0] = parent->keys[i - 1];
+			c->children[0] = l->children[l->count];
+			parent->keys[i - 1] = l->keys[l->count - 1];
+		}
+		child->count++;
+		left->count--;
+	}
+	// borrow the smallest key of the right sibling
+	else if (right && right->count > min_keys) {
+		if (child->is_leaf) {
+			Leaf* c = static_cast<Leaf*>(child);
+			Leaf* r = static_cast<Leaf*>(right);
+			c->keys[c->count] = r->keys[0];
+			c->values[c->count] = r->values[0];
+			std::move(r->keys + 1, r->keys + r->count, r->keys);
+			std::move(r->values + 1, r->values + r->count, r->values);
+			parent->keys[i] = r->keys[0];
+		}
+		else {
+			Inner* c = static_cast<Inner*>(child);
+			Inner* r = static_cast<Inner*>(right);
+			c->keys[c->count] = parent->keys[i];
+			c->children[c->count + 1] = r->children[0];
+			parent->keys[i] = r->keys[0];
+			std::move(r->keys + 1, r->keys + r->count, r->keys);
+			std::copy(r->children + 1, r->children + r->count + 1, r->children);
+		}
+		child->count++;
+		right->count--;
+	}
+	// neither sibling can spare a key, so merge with one of them
+	else if (left)
+		merge(parent, i - 1);
+	else
+		merge(parent, i);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::merge(Inner* parent, int i) {
+	Node* left = parent->children[i];
+	Node* right = parent->children[i + 1];
+	if (left->is_leaf) {
+		Leaf* l = static_cast<Leaf*>(left);
+		Leaf* r = static_cast<Leaf*>(right);
+		std::move(r->keys, r->keys + r->count, l->keys + l->count);
+		std::move(r->values, r->values + r->count, l->values + l->count);
+		l->count += r->count;
+		l->next = r->next;
+		if (l->next)
+			l->next->prev = l;
+		leaves.destroy(r);
+	}
+	else {
+		// the separator comes down between the two halves
+		Inner* l = static_cast<Inner*>(left);
+		Inner* r = static_cast<Inner*>(right);
+		l->keys[l->count] = parent->keys[i];
+		std::move(r->keys, r->keys + r->count, l->keys + l->count + 1);
+		std::copy(r->children, r->children + r->count + 1, l->children + l->count + 1);
+		l->count += r->count + 1;
+		inners.destroy(r);
+	}
+	std::move(parent->keys + i + 1, parent->keys + parent->count, parent->keys + i);
+	std::copy(parent->children + i + 2, parent->children + parent->count + 1, parent->children + i + 1);
+	parent->count--;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::remove(const K& key) {
+	COLLECTION_OP("BTree", OP_REMOVE);
+	if (!root || !remove(root, key))
+		return;
+	collection_size--;
+	// the root is allowed to underflow, but not to be empty
+	if (root->count == 0) {
+		Node* old_root = root;
+		if (root->is_leaf) {
+			root = nullptr;
+			leaves.destroy(static_cast<Leaf*>(old_root));
+		}
+		else {
+			root = static_cast<Inner*>(old_root)->children[0];
+			inners.destroy(static_cast<Inner*>(old_root));
+		}
+	}
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool BTreeCollection<K,V,NodeAlloc>::find(const K& key, V& val) const {
+	COLLECTION_OP("BTree", OP_FIND);
+	const Leaf* leaf = find_leaf(key);
+	if (!leaf)
+		return false;
+	COLLECTION_PROBES(binary_search_probes(leaf->count));
+	int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+	if (i < leaf->count && leaf->keys[i] == key) {
+		val = leaf->values[i];
+		return true;
+	}
+	return false;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::find_batch(const K* ks, int n, V* vals, std::vector<bool>& found) const {
+	found.assign(n, false);
+	if (!root)
+		return;
+
+	const Node* curr[batch_group_size];
+	for (int base = 0; base < n; base += batch_group_size) {
+		int group = std::min(batch_group_size, n - base);
+		for (int j = 0; j < group; j++)
+			curr[j] = root;
+		// every leaf is at the same depth, so the searches finish together
+		while (!curr[0]->is_leaf)
+			for (int j = 0; j < group; j++) {
+				const Inner* inner = static_cast<const Inner*>(curr[j]);
+				int i = std::upper_bound(inner->keys, inner->keys + inner->count, ks[base + j]) - inner->keys;
+				curr[j] = inner->children[i];
+				prefetch(curr[j]);
+			}
+		for (int j = 0; j < group; j++) {
+			const Leaf* leaf = static_cast<const Leaf*>(curr[j]);
+			int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, ks[base + j]) - leaf->keys;
+			if (i < leaf->count && leaf->keys[i] == ks[base + j]) {
+				vals[base + j] = leaf->values[i];
+				found[base + j] = true;
+			}
+		}
+	}
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc> void
+BTreeCollection<K,V,NodeAlloc>::find(const K& k1, const K& k2, std::vector <K>& ks) const {
+	COLLECTION_OP("BTree", OP_RANGE);
+	ks.clear();
+	// start at the first key >= k1 and scan along the leaves
+	const Leaf* leaf = find_leaf(k1);
+	if (!leaf)
+		return;
+	COLLECTION_PROBES(binary_search_probes(leaf->count));
+	int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, k1) - leaf->keys;
+	while (leaf) {
+		for (; i < leaf->count; i++) {
+			COLLECTION_PROBES(1);
+			if (leaf->keys[i] > k2)
+				return;
+			ks.push_back(leaf->keys[i]);
+		}
+		leaf = leaf->next;
+		i = 0;
+	}
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::keys(std::vector <K>& ks) const {
+	ks.clear();
+	ks.reserve(collection_size);
+	const Node* curr = root;
+	if (!curr)
+		return;
+	// walk down to the leftmost leaf and then along the leaves
+	while (!curr->is_leaf)
+		curr = static_cast<const Inner*>(curr)->children[0];
+	for (const Leaf* leaf = static_cast<const Leaf*>(curr); leaf; leaf = leaf->next)
+		ks.insert(ks.end(), leaf->keys, leaf->keys + leaf->count);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::sort(std::vector <K>& ks) const {
+	// the leaves are already in key order
+	keys(ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::scan_in_parallel(const K* k1, const K* k2, std::vector <K>& ks, ThreadPool& pool) const {
+	ks.clear();
+	if (!root)
+		return;
+	// go down a level at a time, keeping the children that can hold keys
+	// in range, until there are enough subtrees for each thread to steal a few
+	std::vector<const Node*> level(1, root);
+	while (!level.empty() && static_cast<int>(level.size()) < parallel_pieces(pool) && !level[0]->is_leaf) {
+		std::vector<const Node*> below;
+		for (const Node* node : level) {
+			const Inner* inner = static_cast<const Inner*>(node);
+			for (int i = 0; i <= inner->count; i++)
+				if ((!k2 || i == 0 || !(*k2 < inner->keys[i - 1])) &&
+				    (!k1 || i == inner->count || *k1 < inner->keys[i]))
+					below.push_back(inner->children[i]);
+		}
+		level.swap(below);
+	}
+	if (level.empty())
+		return;
+	// run i is the leaves from the leftmost one under level[i] up to the
+	// leftmost one under level[i+1]
+	std::vector<const Leaf*> first(level.size() + 1, nullptr);
+	for (size_t i = 0; i < level.size(); i++) {
+		const Node* curr = level[i];
+		while (!curr->is_leaf)
+			curr = static_cast<const Inner*>(curr)->children[0];
+		first[i] = static_cast<const Leaf*>(curr);
+	}
+	// the last run ends after the rightmost leaf under the last subtree
+	const Node* curr = level.back();
+	while (!curr->is_leaf)
+		curr = static_cast<const Inner*>(curr)->children[curr->count];
+	first[level.size()] = static_cast<const Leaf*>(curr)->next;
+	std::vector<std::vector<K>> parts(level.size());
+	parallel_for(pool, level.size(), [&](int i) {
+		for (const Leaf* leaf = first[i]; leaf != first[i + 1]; leaf = leaf->next) {
+			const K* begin = leaf->keys;
+			const K* end = leaf->keys + leaf->count;
+			if (k1)
+				begin = std::lower_bound(begin, end, *k1);
+			if (k2)
+				end = std::upper_bound(begin, end, *k2);
+			parts[i].insert(parts[i].end(), begin, end);
+		}
+	});
+	concat_in_parallel(pool, parts, ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::parallel_keys(std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		keys(ks);
+		return;
+	}
+	scan_in_parallel(nullptr, nullptr, ks, pool);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::parallel_sort(std::vector <K>& ks, ThreadPool& pool) const {
+	// the leaves are already in key order
+	parallel_keys(ks, pool);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::parallel_find(const K& k1, const K& k2, std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		find(k1, k2, ks);
+		return;
+	}
+	scan_in_parallel(&k1, &k2, ks, pool);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int BTreeCollection<K,V,NodeAlloc>::size() const {
+	return collection_size;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int BTreeCollection<K,V,NodeAlloc>::height() const {
+	// every leaf is at the same depth
+	int levels = 0;
+	for (const Node* curr = root; curr; levels++)
+		curr = curr->is_leaf ? nullptr : static_cast<const Inner*>(curr)->children[0];
+	return levels;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	const Node* curr = root;
+	if (!curr)
+		return;
+	while (!curr->is_leaf)
+		curr = static_cast<const Inner*>(curr)->children[0];
+	for (const Leaf* leaf = static_cast<const Leaf*>(curr); leaf; leaf = leaf->next)
+		for (int i = 0; i < leaf->count; i++)
+			if (!visitor(leaf->keys[i], leaf->values[i]))
+				return;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	const Leaf* leaf = find_leaf(k1);
+	if (!leaf)
+		return;
+	int i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, k1) - leaf->keys;
+	for (; leaf; leaf = leaf->next, i = 0)
+		for (; i < leaf->count; i++)
+			if (leaf->keys[i] > k2 || !visitor(leaf->keys[i], leaf->values[i]))
+				return;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Iter>
+void BTreeCollection<K,V,NodeAlloc>::bulk_load(Iter begin, Iter end) {
+	if (!keys_ascending(begin, end)) {
+		std::vector<std::pair<K,V>> sorted;
+		sort_by_key(begin, end, sorted);
+		bulk_load(sorted.begin(), sorted.end());
+		return;
+	}
+	make_empty();
+	int n = std::distance(begin, end);
+	if (n == 0)
+		return;
+	// fill the leaves left to right, then each level of inner nodes above
+	std::vector<std::pair<Node*,K>> level;
+	build_leaves(begin, n, level);
+	while (level.size() > 1)
+		build_level(level);
+	root = level[0].first;
+	collection_size = n;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Iter>
+void BTreeCollection<K,V,NodeAlloc>::build_leaves(Iter it, int n, std::vector<std::pair<Node*,K>>& level) {
+	// spread the pairs evenly so every leaf has at least min_keys
+	int count = (n + max_keys - 1) / max_keys;
+	Leaf* prev = nullptr;
+	for (int i = 0; i < count; i++) {
+		Leaf* leaf = new_leaf();
+		leaf->count = n / count + (i < n % count);
+		for (int j = 0; j < leaf->count; j++, ++it) {
+			leaf->keys[j] = it->first;
+			leaf->values[j] = it->second;
+		}
+		leaf->prev = prev;
+		if (prev)
+			prev->next = leaf;
+		prev = leaf;
+		level.push_back(std::make_pair(leaf, leaf->keys[0]));
+	}
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void BTreeCollection<K,V,NodeAlloc>::build_level(std::vector<std::pair<Node*,K>>& level) {
+	// spread the children evenly so every inner node has at least
+	// min_keys + 1 of them
+	int n = level.size();
+	int count = (n + max_keys) / (max_keys + 1);
+	std::vector<std::pair<Node*,K>> parents;
+	int next = 0;
+	for (int i = 0; i < count; i++) {
+		Inner* inner = new_inner();
+		int children = n / count + (i < n % count);
+		inner->count = children - 1;
+		for (int j = 0; j < children; j++, next++) {
+			inner->children[j] = level[next].first;
+			if (j > 0)
+				inner->keys[j - 1] = level[next].second;
+		}
+		parents.push_back(std::make_pair(inner, level[next - children].second));
+	}
+	level.swap(parents);
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Helpers shared by the bulk_load() functions of the ordered
+collections. The input is a range of key-value pairs (anything with first
+and second, e.g. a std::map or a vector of std::pair). If the keys are
+already strictly ascending a collection builds straight from the range in
+one pass, otherwise the pairs are first copied into a sorted vector with
+one pair per key.
+*/
+
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+
+// return true if the keys in [begin, end) are strictly ascending
+template <typename Iter>
+bool keys_ascending(Iter begin, Iter end) {
+	if (begin == end)
+		return true;
+	Iter prev = begin;
+	for (Iter it = std::next(begin); it != end; prev = it, ++it)
+		if (!(prev->first < it->first))
+			return false;
+	return true;
+}
+
+
+// copy [begin, end) into sorted in ascending key order, keeping the last
+// value given for a repeated key
+template <typename K, typename V, typename Iter>
+void sort_by_key(Iter begin, Iter end, std::vector<std::pair<K,V>>& sorted) {
+	sorted.clear();
+	for (Iter it = begin; it != end; ++it)
+		sorted.emplace_back(it->first, it->second);
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const std::pair<K,V>& a, const std::pair<K,V>& b) { return a.first < b.first; });
+	// keep only the last pair of each run of equal keys
+	int n = 0;
+	for (int i = 0; i < (int) sorted.size(); i++) {
+		if (i + 1 < (int) sorted.size() && !(sorted[i].first < sorted[i + 1].first))
+			continue;
+		if (n != i)
+			sorted[n] = std::move(sorted[i]);
+		n++;
+	}
+	sorted.erase(sorted.begin() + n, sorted.end());
+}
+
+#endif
@@ -0,0 +1,488 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Bounded cache implementing Collection. It holds entries up to
+a capacity, counted in entries or in a weight per entry (such as its size
+in bytes), and evicts entries to stay within it by one of three policies:
+
+	EVICT_LRU      - evict the least recently used entry (a hit moves the
+	                 entry to the back of a list)
+	EVICT_CLOCK    - approximate LRU: a hit only sets the entry's
+	                 reference bit, and a hand sweeping the entries in
+	                 insertion order evicts the first one without it
+	                 (clearing the bits it passes)
+	EVICT_S3_FIFO  - new entries go into a small FIFO queue (a tenth of
+	                 the capacity) and only move to the main FIFO queue
+	                 if hit again before they leave it; the main queue
+	                 gives entries a new pass for each of their recent hits
+	                 (up to 3), and keys recently evicted from the small
+	                 queue are remembered so they go straight to main if
+	                 inserted again (resists scans, a hit is one increment)
+
+A hash index from key to entry makes find(), insert() and remove() O(1)
+(amortized over the evictions). find() is const as in Collection, but a
+hit updates the policy's state and the hit and miss counters. Range find,
+keys() and sort() scan every entry.
+*/
+
+#ifndef CACHE_COLLECTION_H
+#define CACHE_COLLECTION_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include "collection.h"
+#include "node_allocator.h"
+#include "open_hash_table_collection.h"
+#include "instrumentation.h"
+
+
+// which entry a CacheCollection evicts when full
+enum EvictionPolicy { EVICT_LRU, EVICT_CLOCK, EVICT_S3_FIFO };
+
+
+// counters of a cache since it was created or its stats were reset
+struct CacheStats {
+	long hits;
+	long misses;
+	long evictions;
+};
+
+
+// weight of an entry as the bytes of its key and value (use with a cache
+// whose capacity is in bytes, for keys and values that own no other memory)
+template <typename K, typename V>
+long cache_entry_bytes(const K& key, const V& val) {
+	return sizeof(K) + sizeof(V);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool>
+class CacheCollection : public Collection<K,V> {
+public:
+
+	// create a cache holding up to capacity entries
+	CacheCollection(long capacity, EvictionPolicy policy = EVICT_LRU);
+
+	// create a cache holding entries up to a total weight of capacity,
+	// where weigh gives the weight of an entry (e.g. cache_entry_bytes)
+	CacheCollection(long capacity, EvictionPolicy policy, const std::function<long(const K&, const V&)>& weigh);
+
+	// a cache is not copied
+	CacheCollection(const CacheCollection<K,V,NodeAlloc>& rhs) = delete;
+	CacheCollection<K,V,NodeAlloc>& operator =(const CacheCollection<K,V,NodeAlloc>& rhs) = delete;
+
+	// delete a cache
+	~CacheCollection();
+
+	// insert a key-value pair (replaces the value, and counts as a use, if
+	// the key is present), evicting entries until the cache is within its
+	// capacity (an entry heavier than the whole capacity is not kept)
+	void insert(const K& key, const V& val);
+
+	// remove a key-value pair from the collection
+	void remove(const K& key);
+
+	// find the value associated with the key, counting a hit or a miss
+	bool find(const K& key, V& val) const;
+
+	// find the keys associated with the range
+	void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+	// return all keys in the collection
+	void keys(std::vector<K>& keys) const;
+
+	// return collection keys in sorted order
+	void sort(std::vector<K>& keys) const;
+
+	// return the number of keys in collection
+	int size() const;
+
+	// call visitor on each key-value pair until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// return the capacity and the total weight of the entries held
+	long capacity() const;
+	long weight() const;
+
+	// return the hit, miss and eviction counts (reset_stats() zeroes them)
+	CacheStats stats() const;
+	void reset_stats();
+
+private:
+
+	// cache entry, in one of the queues
+	struct Entry {
+		template <typename KArg, typename VArg>
+		Entry(KArg&& k, VArg&& v): key(std::forward<KArg>(k)), value(std::forward<VArg>(v)) {}
+
+		K key;
+		V value;
+		long weight;
+		Entry* prev;
+		Entry* next;
+		// reference bit (CLOCK) or recent hits (S3-FIFO)
+		unsigned char hits;
+		// the queue holding the entry
+		unsigned char queue;
+	};
+
+	// doubly linked list of entries with their count and weight
+	struct Queue {
+		Entry* head;
+		Entry* tail;
+		int count;
+		long weight;
+	};
+
+	// the queues: LRU and CLOCK keep every entry in SMALL (in use order
+	// or insertion order), S3-FIFO uses both
+	static const int SMALL = 0;
+	static const int MAIN = 1;
+
+	// most hits counted for an entry in the S3-FIFO main queue
+	static const int max_hits = 3;
+
+	// link e in at the back of queue q, or before e's successor to be
+	// (CLOCK puts new entries just behind its hand)
+	void push_back(int q, Entry* e) const;
+	void insert_before(Entry* next, Entry* e) const;
+
+	// take e out of its queue
+	void unlink(Entry* e) const;
+
+	// record a hit on e
+	void touch(Entry* e) const;
+
+	// evict one entry by the policy
+	void evict();
+
+	// remember a key evicted from the S3-FIFO small queue
+	void add_ghost(const K& key);
+
+	long max_weight;
+	EvictionPolicy policy;
+	std::function<long(const K&, const V&)> weigh;
+
+	// the entries by key
+	OpenHashTableCollection<K,Entry*> index;
+
+	// queue order and the CLOCK hand change on hits, in const find()
+	mutable Queue queues[2];
+	mutable Entry* hand;
+	mutable CacheStats cache_stats;
+
+	// keys recently evicted from the S3-FIFO small queue, oldest first,
+	// each with its number (a key taken out of ghost_index early leaves its
+	// stale place in ghost_keys)
+	std::deque<std::pair<K,long>> ghost_keys;
+	OpenHashTableCollection<K,long> ghost_index;
+	long ghost_count;
+
+	// allocator for the entries
+	NodeAlloc<Entry> entries;
+};
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+CacheCollection<K,V,NodeAlloc>::CacheCollection(long capacity, EvictionPolicy policy):
+	CacheCollection(capacity, policy, nullptr) {}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+CacheCollection<K,V,NodeAlloc>::CacheCollection(long capacity, EvictionPolicy policy,
+	const std::function<long(const K&, const V&)>& weigh): max_weight(capacity), policy(policy), weigh(weigh),
+	hand(nullptr), ghost_count(0) {
+	for (Queue& q : queues)
+		q = Queue{nullptr, nullptr, 0, 0};
+	reset_stats();
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+CacheCollection<K,V,NodeAlloc>::~CacheCollection() {
+	// a pool frees all the entries at once, so they only need to be
+	// visited if they have destructors to run
+	if (!NodeAlloc<Entry>::bulk_release || !std::is_trivially_destructible<Entry>::value)
+		for (Queue& q : queues)
+			for (Entry* e = q.head; e != nullptr; ) {
+				Entry* next = e->next;
+				entries.destroy(e);
+				e = next;
+			}
+	entries.release();
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::push_back(int q, Entry* e) const {
+	Queue& queue = queues[q];
+	e->queue = q;
+	e->next = nullptr;
+	e->prev = queue.tail;
+	if (queue.tail)
+		queue.tail->next = e;
+	else
+		queue.head = e;
+	queue.tail = e;
+	queue.count++;
+	queue.weight += e->weight;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::insert_before(Entry* next, Entry* e) const {
+	Queue& queue = queues[next->queue];
+	e->queue = next->queue;
+	e->next = next;
+	e->prev = next->prev;
+	if (next->prev)
+		next->prev->next = e;
+	else
+		queue.head = e;
+	next->prev = e;
+	queue.count++;
+	queue.weight += e->weight;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::unlink(Entry* e) const {
+	Queue& queue = queues[e->queue];
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		queue.head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		queue.tail = e->prev;
+	queue.count--;
+	queue.weight -= e->weight;
+	// the CLOCK hand moves on to the next entry (round to the front)
+	if (hand == e)
+		hand = e->next ? e->next : queue.head;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::touch(Entry* e) const {
+	switch (policy) {
+		case EVICT_LRU:
+			if (e != queues[SMALL].tail) {
+				unlink(e);
+				push_back(SMALL, e);
+			}
+			break;
+		case EVICT_CLOCK:
+			e->hits = 1;
+			break;
+		case EVICT_S3_FIFO:
+			if (e->hits < max_hits)
+				e->hits++;
+			break;
+	}
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::insert(const K& key, const V& val) {
+	COLLECTION_OP("Cache", OP_INSERT);
+	long w = weigh ? weigh(key, val) : 1;
+	Entry* e;
+	if (index.find(key, e)) {
+		// replace the value in place, reweighing the entry
+		queues[e->queue].weight += w - e->weight;
+		e->weight = w;
+		e->value = val;
+		touch(e);
+	}
+	else {
+		e = entries.create(key, val);
+		e->weight = w;
+		e->hits = 0;
+		long seen;
+		if (policy == EVICT_S3_FIFO && ghost_index.find(key, seen)) {
+			// evicted from the small queue not long ago, so it was wanted
+			// again soon: straight to main
+			ghost_index.remove(key);
+			push_back(MAIN, e);
+		}
+		else if (policy == EVICT_CLOCK && hand)
+			insert_before(hand, e);
+		else
+			push_back(SMALL, e);
+		if (policy == EVICT_CLOCK && !hand)
+			hand = e;
+		index.insert(key, e);
+	}
+	if (w > max_weight) {
+		// heavier than the whole cache, so it cannot stay
+		index.remove(key);
+		unlink(e);
+		entries.destroy(e);
+		return;
+	}
+	while (weight() > max_weight)
+		evict();
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::evict() {
+	Entry* victim = nullptr;
+	switch (policy) {
+		case EVICT_LRU:
+			victim = queues[SMALL].head;
+			unlink(victim);
+			break;
+		case EVICT_CLOCK:
+			// give each referenced entry the hand passes another round
+			while (hand->hits) {
+				hand->hits = 0;
+				hand = hand->next ? hand->next : queues[SMALL].head;
+			}
+			victim = hand;
+			unlink(victim);
+			break;
+		case EVICT_S3_FIFO:
+			// move entries on until one leaves the cache
+			while (!victim) {
+				Queue& small = queues[SMALL];
+				if (small.head && (small.weight > max_weight / 10 || !queues[MAIN].head)) {
+					Entry* e = small.head;
+					unlink(e);
+					if (e->hits > 0) {
+						// hit again while in the small queue: keep it
+						e->hits = 0;
+						push_back(MAIN, e);
+					}
+					else {
+						add_ghost(e->key);
+						victim = e;
+					}
+				}
+				else {
+					Entry* e = queues[MAIN].head;
+					unlink(e);
+					if (e->hits > 0) {
+						e->hits--;
+						push_back(MAIN, e);
+					}
+					else
+						victim = e;
+				}
+			}
+			break;
+	}
+	index.remove(victim->key);
+	entries.destroy(victim);
+	cache_stats.evictions++;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::add_ghost(const K& key) {
+	ghost_index.insert(key, ghost_count);
+	ghost_keys.emplace_back(key, ghost_count);
+	ghost_count++;
+	// remember about as many keys as the cache holds
+	while ((int) ghost_keys.size() > std::max(index.size(), 1)) {
+		long seen;
+		if (ghost_index.find(ghost_keys.front().first, seen) && seen == ghost_keys.front().second)
+			ghost_index.remove(ghost_keys.front().first);
+		ghost_keys.pop_front();
+	}
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::remove(const K& key) {
+	COLLECTION_OP("Cache", OP_REMOVE);
+	Entry* e;
+	if (!index.find(key, e))
+		return;
+	index.remove(key);
+	unlink(e);
+	entries.destroy(e);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool CacheCollection<K,V,NodeAlloc>::find(const K& key, V& val) const {
+	COLLECTION_OP("Cache", OP_FIND);
+	Entry* e;
+	if (!index.find(key, e)) {
+		cache_stats.misses++;
+		return false;
+	}
+	cache_stats.hits++;
+	touch(e);
+	val = e->value;
+	return true;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::find(const K& k1, const K& k2, std::vector<K>& ks) const {
+	COLLECTION_OP("Cache", OP_RANGE);
+	ks.clear();
+	for (const Queue& q : queues)
+		for (const Entry* e = q.head; e != nullptr; e = e->next)
+			if (e->key >= k1 && e->key <= k2)
+				ks.push_back(e->key);
+	COLLECTION_PROBES(size());
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::keys(std::vector<K>& ks) const {
+	ks.clear();
+	ks.reserve(size());
+	for (const Queue& q : queues)
+		for (const Entry* e = q.head; e != nullptr; e = e->next)
+			ks.push_back(e->key);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::sort(std::vector<K>& ks) const {
+	keys(ks);
+	std::sort(ks.begin(), ks.end());
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int CacheCollection<K,V,NodeAlloc>::size() const {
+	return queues[SMALL].count + queues[MAIN].count;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	for (const Queue& q : queues)
+		for (const Entry* e = q.head; e != nullptr; e = e->next)
+			if (!visitor(e->key, e->value))
+				return;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	for (const Queue& q : queues)
+		for (const Entry* e = q.head; e != nullptr; e = e->next)
+			if (e->key >= k1 && e->key <= k2 && !visitor(e->key, e->value))
+				return;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+long CacheCollection<K,V,NodeAlloc>::capacity() const {
+	return max_weight;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+long CacheCollection<K,V,NodeAlloc>::weight() const {
+	return queues[SMALL].weight + queues[MAIN].weight;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+CacheStats CacheCollection<K,V,NodeAlloc>::stats() const {
+	return cache_stats;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void CacheCollection<K,V,NodeAlloc>::reset_stats() {
+	cache_stats = CacheStats{0, 0, 0};
+}
+
+#endif
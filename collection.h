@@ -3,6 +3,12 @@
 #define COLLECTION_H
 
 #include <vector>
+#include <functional>
+#include "thread_pool.h"
+
+
+// number of lookups the find_batch() overrides keep in flight at a time
+const int batch_group_size = 16;
 
 template <typename K, typename V>
 class Collection{
@@ -10,6 +16,10 @@ class Collection{
 		// insert a key - value pair into the collection
 		virtual void insert(const K& key, const V& val) = 0;
 
+		// insert a key - value pair, moving the key and value into the
+		// collection where it supports that (by default they are copied)
+		virtual void insert(K&& key, V&& val);
+
 		// remove a key - value pair from the collectiona
 		virtual void remove(const K& key) = 0;
 
@@ -19,6 +29,12 @@ class Collection{
 		// find and return the list of keys >= to k1 and <= to k2
 		virtual void find(const K& k1, const K& k2, std::vector<K>& keys) const = 0;
 
+		// look up keys[0..n-1] at once: found[i] is whether keys[i] is in the
+		// collection and, if it is, vals[i] is set to its value (by default
+		// each key is found in turn; the hash tables and trees overlap the
+		// cache misses of the lookups)
+		virtual void find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const;
+
 		// return all of the keys in the collection
 		virtual void keys(std::vector<K>&keys) const = 0;
 
@@ -27,6 +43,73 @@ class Collection{
 
 		// return the number of keys in the collection
 		virtual int size() const = 0;
+
+		// call visitor on each key - value pair in the collection until it
+		// returns false (in ascending key order for the ordered collections)
+		virtual void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// call visitor on each key - value pair with k1 <= key <= k2 until
+		// it returns false (in ascending key order for the ordered collections)
+		virtual void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// the same as keys(), sort() and find(k1, k2, keys) but with the work
+		// split across the threads of pool; the results are the same as the
+		// single threaded versions (by default they just call them)
+		virtual void parallel_keys(std::vector<K>& keys, ThreadPool& pool) const;
+		virtual void parallel_sort(std::vector<K>& keys, ThreadPool& pool) const;
+		virtual void parallel_find(const K& k1, const K& k2, std::vector<K>& keys, ThreadPool& pool) const;
+
+		virtual ~Collection() {}
 };
 
+
+template <typename K, typename V>
+void Collection<K,V>::insert(K&& key, V&& val) {
+	insert(static_cast<const K&>(key), static_cast<const V&>(val));
+}
+
+// by default look up each key, the collections override these to walk
+// their own storage without copying the keys
+template <typename K, typename V>
+void Collection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	std::vector<K> ks;
+	keys(ks);
+	V val;
+	for (const K& key : ks)
+		if (find(key, val) && !visitor(key, val))
+			return;
+}
+
+template <typename K, typename V>
+void Collection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	std::vector<K> ks;
+	keys(ks);
+	V val;
+	for (const K& key : ks)
+		if (key >= k1 && key <= k2 && find(key, val) && !visitor(key, val))
+			return;
+}
+
+template <typename K, typename V>
+void Collection<K,V>::find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const {
+	found.assign(n, false);
+	for (int i = 0; i < n; i++)
+		found[i] = find(keys[i], vals[i]);
+}
+
+template <typename K, typename V>
+void Collection<K,V>::parallel_keys(std::vector<K>& ks, ThreadPool&) const {
+	keys(ks);
+}
+
+template <typename K, typename V>
+void Collection<K,V>::parallel_sort(std::vector<K>& ks, ThreadPool&) const {
+	sort(ks);
+}
+
+template <typename K, typename V>
+void Collection<K,V>::parallel_find(const K& k1, const K& k2, std::vector<K>& ks, ThreadPool&) const {
+	find(k1, k2, ks);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,225 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Multi-threaded benchmark for the collections that can be shared
+between threads. Each run fills a collection, then has 1, 2, 4, ... up to N
+threads do a mix of find, insert and remove calls on random keys and reports
+the combined throughput in ops/sec. Each collection is run alongside a
+sequential one of the same kind behind one global mutex for comparison:
+the hash tables for unordered access, and for ordered access the red-black
+tree against the skip list and the persistent red-black tree (lock-free
+reads, one writer at a time). Last, one thread inserts into the persistent
+tree while another holds a snapshot through all of it, as a long scan
+would, against the same inserts with no snapshot: every node the writes
+replace must wait for the snapshot, which should cost memory but not time.
+
+usage: concurrent_benchmark [max threads] [keys] [ops per thread] [find %]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include "collection.h"
+#include "hash_table_collection.h"
+#include "concurrent_hash_table_collection.h"
+#include "dbl_rbt_collection.h"
+#include "concurrent_skiplist_collection.h"
+#include "persistent_rbt_collection.h"
+
+
+// wraps a collection so that every call holds one global lock
+template <typename K, typename V, typename C>
+class LockedCollection : public Collection<K,V> {
+public:
+	void insert(const K& key, const V& val) {
+		std::lock_guard<std::mutex> guard(lock);
+		collection.insert(key, val);
+	}
+	void remove(const K& key) {
+		std::lock_guard<std::mutex> guard(lock);
+		collection.remove(key);
+	}
+	bool find(const K& key, V& val) const {
+		std::lock_guard<std::mutex> guard(lock);
+		return collection.find(key, val);
+	}
+	void find(const K& k1, const K& k2, std::vector<K>& keys) const {
+		std::lock_guard<std::mutex> guard(lock);
+		collection.find(k1, k2, keys);
+	}
+	void keys(std::vector<K>& keys) const {
+		std::lock_guard<std::mutex> guard(lock);
+		collection.keys(keys);
+	}
+	void sort(std::vector<K>& keys) const {
+		std::lock_guard<std::mutex> guard(lock);
+		collection.sort(keys);
+	}
+	int size() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return collection.size();
+	}
+private:
+	mutable std::mutex lock;
+	C collection;
+};
+
+
+// the checksum of every thread's finds is added here, so the compiler
+// cannot drop the finds that produce it
+std::atomic<long> checksum_sink(0);
+
+
+// benchmark settings
+struct Settings {
+	int max_threads;
+	int keys;
+	int ops_per_thread;
+	int find_percent;
+};
+
+
+// run the mixed workload on the given number of threads and return ops/sec
+double run(Collection<long,long>& c, const Settings& s, int threads) {
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([&c, &s, &ready, &go, t]() {
+			std::mt19937_64 rng(1234 + t);
+			long sum = 0;
+			ready++;
+			while (!go.load())
+				std::this_thread::yield();
+			for (int i = 0; i < s.ops_per_thread; i++) {
+				long key = rng() % (2L * s.keys);
+				int op = rng() % 100;
+				long val;
+				if (op < s.find_percent) {
+					if (c.find(key, val))
+						sum += val;
+				}
+				else if (op % 2 == 0)
+					c.insert(key, key);
+				else
+					c.remove(key);
+			}
+			checksum_sink.fetch_add(sum, std::memory_order_relaxed);
+		}));
+	}
+	while (ready.load() < threads)
+		std::this_thread::yield();
+	auto start = std::chrono::steady_clock::now();
+	go = true;
+	for (std::thread& w : workers)
+		w.join();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(threads) * s.ops_per_thread / elapsed.count();
+}
+
+
+// run the collection type at 1, 2, 4, ... max_threads threads
+template <typename C>
+void scale(const std::string& name, const Settings& s) {
+	for (int threads = 1; ; threads *= 2) {
+		if (threads > s.max_threads)
+			threads = s.max_threads;
+		C c;
+		std::mt19937_64 rng(99);
+		for (int i = 0; i < s.keys; i++) {
+			long key = rng() % (2L * s.keys);
+			c.insert(key, key);
+		}
+		double ops = run(c, s, threads);
+		std::cout << std::left << std::setw(28) << name << std::right << std::setw(8) << threads
+		          << std::setw(16) << std::fixed << std::setprecision(0) << ops << std::endl;
+		if (threads == s.max_threads)
+			break;
+	}
+}
+
+
+// inserts timed while a snapshot is held (each keeps a path of nodes
+// alive until the snapshot goes, so this bounds the memory used)
+const int snapshot_inserts = 100000;
+
+// insert snapshot_inserts random keys into a filled PersistentRBTCollection
+// and return inserts/sec, with another thread holding a snapshot from
+// before the first insert to after the last if held is set
+double snapshot_writes(const Settings& s, bool held) {
+	PersistentRBTCollection<long,long> c;
+	std::mt19937_64 rng(99);
+	for (int i = 0; i < s.keys; i++) {
+		long key = rng() % (2L * s.keys);
+		c.insert(key, key);
+	}
+	std::atomic<bool> taken(false);
+	std::atomic<bool> done(false);
+	std::thread reader;
+	if (held) {
+		reader = std::thread([&c, &taken, &done]() {
+			PersistentRBTCollection<long,long>::Snapshot snapshot = c.snapshot();
+			taken = true;
+			while (!done.load())
+				std::this_thread::yield();
+			// the scan still sees the tree from before the inserts
+			std::vector<long> ks;
+			snapshot.keys(ks);
+			checksum_sink.fetch_add(ks.size(), std::memory_order_relaxed);
+		});
+		while (!taken.load())
+			std::this_thread::yield();
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < snapshot_inserts; i++) {
+		long key = rng() % (2L * s.keys);
+		c.insert(key, key);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	done = true;
+	if (held)
+		reader.join();
+	return snapshot_inserts / elapsed.count();
+}
+
+
+int main(int argc, char** argv) {
+	Settings s;
+	s.max_threads = std::thread::hardware_concurrency();
+	if (s.max_threads < 1)
+		s.max_threads = 1;
+	s.keys = 100000;
+	s.ops_per_thread = 1000000;
+	s.find_percent = 90;
+	// counts below 1 (or not numbers) would leave nothing to run or
+	// divide by zero, so they count as 1
+	if (argc > 1)
+		s.max_threads = std::max(1, std::atoi(argv[1]));
+	if (argc > 2)
+		s.keys = std::max(1, std::atoi(argv[2]));
+	if (argc > 3)
+		s.ops_per_thread = std::max(1, std::atoi(argv[3]));
+	if (argc > 4)
+		s.find_percent = std::atoi(argv[4]);
+
+	std::cout << std::left << std::setw(28) << "collection" << std::right << std::setw(8) << "threads"
+	          << std::setw(16) << "ops/sec" << std::endl;
+	scale<LockedCollection<long,long,HashTableCollection<long,long>>>("HashTableCollection+mutex", s);
+	scale<ConcurrentHashTableCollection<long,long>>("ConcurrentHashTable", s);
+	scale<LockedCollection<long,long,RBTCollection<long,long>>>("RBTCollection+mutex", s);
+	scale<ConcurrentSkipListCollection<long,long>>("ConcurrentSkipList", s);
+	scale<PersistentRBTCollection<long,long>>("PersistentRBT", s);
+	std::cout << std::left << std::setw(28) << "PersistentRBT inserts" << std::right << std::setw(8) << 1
+	          << std::setw(16) << std::fixed << std::setprecision(0) << snapshot_writes(s, false) << std::endl;
+	std::cout << std::left << std::setw(28) << "PersistentRBT inserts+snap" << std::right << std::setw(8) << 1
+	          << std::setw(16) << std::fixed << std::setprecision(0) << snapshot_writes(s, true) << std::endl;
+	return 0;
+}
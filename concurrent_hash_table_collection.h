@@ -0,0 +1,413 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Implementation of Collection using a hash table that can be
+shared between threads. The buckets are split into lock stripes, so a
+find() only takes a shared lock on its own stripe and never waits on a
+writer working in another stripe. A resize copies the chains into a new
+table while holding every stripe shared (writers wait, readers do not),
+then swaps the table in and frees the old one once the readers that may
+still be using it have left.
+*/
+
+#ifndef CONCURRENT_HASH_TABLE_COLLECTION_H
+#define CONCURRENT_HASH_TABLE_COLLECTION_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include "collection.h"
+#include "instrumentation.h"
+
+template <typename K, typename V>
+class ConcurrentHashTableCollection: public Collection<K,V> {
+	public:
+		// create an empty hash table
+		ConcurrentHashTableCollection();
+
+		// copy a hash table (rhs may be in use by other threads, this
+		// object may not)
+		ConcurrentHashTableCollection(const ConcurrentHashTableCollection<K,V>& rhs);
+
+		// assign a hash table (rhs may be in use by other threads, this
+		// object may not)
+		ConcurrentHashTableCollection<K,V>& operator =(const ConcurrentHashTableCollection<K,V>& rhs);
+
+		// delete a hash table
+		~ConcurrentHashTableCollection();
+
+		// insert a key-value pair into the collection (replaces the
+		// value if the key is already present)
+		void insert(const K& key, const V& val);
+
+		// remove a key-value pair from the collection
+		void remove(const K& key);
+
+		// find the value associated with the key
+		bool find(const K& key, V& val) const;
+
+		// find the keys associated with the range
+		void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+		// return all keys in the collection
+		void keys(std::vector<K>& keys) const;
+
+		// return collection keys in sorted order
+		void sort(std::vector<K>& keys) const;
+
+		// return the number of keys in collection
+		int size() const;
+
+		// call visitor on each key-value pair until it returns false
+		void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// call visitor on each key-value pair with k1 <= key <= k2
+		// until it returns false
+		void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	private:
+		// linked list node structure
+		struct Node {
+			K key;
+			V value;
+			Node* next;
+		};
+
+		// bucket array and its size
+		struct Table {
+			int capacity;
+			Node** buckets;
+		};
+
+		// a lock padded out to its own cache line
+		struct alignas(64) Stripe {
+			std::shared_mutex lock;
+		};
+
+		// number of lock stripes (bucket i is guarded by stripe
+		// i % stripe_count, and the table capacity is always a multiple
+		// of it, so a key keeps its stripe across resizes)
+		static const int stripe_count = 64;
+
+		// allocate a table with empty chains
+		static Table* new_table(int capacity);
+
+		// delete a table and all of its nodes
+		static void delete_table(Table* table);
+
+		// hash a key
+		static size_t hash(const K& key);
+
+		// double the table if it is over the load factor threshold
+		void resize_and_rehash();
+
+		// copy every key-value pair of rhs into this (empty) object
+		void copy_from(const ConcurrentHashTableCollection<K,V>& rhs);
+
+		// lock or unlock every stripe for reading
+		void lock_all_shared() const;
+		void unlock_all_shared() const;
+
+		// call visitor on each key-value pair (in the range if k1 and k2
+		// are set) until it returns false
+		void visit(const K* k1, const K* k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// number of k-v pairs in the collection
+	std::atomic<int> collection_size;
+
+	// hash table array load factor (set at 75% for resizing)
+	const double load_factor_threshold;
+
+	// current hash table (read while holding a stripe lock)
+	std::atomic<Table*> table;
+
+	// one lock per stripe of buckets
+	mutable Stripe stripes[stripe_count];
+
+	// only one thread resizes at a time
+	std::mutex resize_lock;
+};
+
+
+template <typename K, typename V>
+ConcurrentHashTableCollection<K,V>::ConcurrentHashTableCollection(): collection_size(0), load_factor_threshold(0.75),
+	table(new_table(stripe_count)) {}
+
+template <typename K, typename V>
+typename ConcurrentHashTableCollection<K,V>::Table* ConcurrentHashTableCollection<K,V>::new_table(int capacity) {
+	Table* t = new Table;
+	t->capacity = capacity;
+	t->buckets = new Node*[capacity];
+	for (int i = 0; i < capacity; ++i)
+		t->buckets[i] = nullptr;
+	return t;
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::delete_table(Table* t) {
+	if (!t)
+		return;
+	for (int i = 0; i < t->capacity; i++) {
+		Node* curr_node = t->buckets[i];
+		while (curr_node) {
+			Node* previous = curr_node;
+			curr_node = curr_node->next;
+			delete previous;
+		}
+	}
+	delete[] t->buckets;
+	delete t;
+}
+
+template <typename K, typename V>
+ConcurrentHashTableCollection<K,V>::~ConcurrentHashTableCollection() {
+	delete_table(table.load());
+}
+
+template <typename K, typename V>
+ConcurrentHashTableCollection<K,V>::ConcurrentHashTableCollection(const ConcurrentHashTableCollection<K,V>& rhs):
+	collection_size(0), load_factor_threshold(rhs.load_factor_threshold), table(nullptr) {
+	copy_from(rhs);
+}
+
+template <typename K, typename V>
+ConcurrentHashTableCollection<K,V>& ConcurrentHashTableCollection<K,V>::operator=(const ConcurrentHashTableCollection<K,V>& rhs) {
+	// check if rhs is current object and return current object
+	if (this == &rhs)
+		return *this;
+	delete_table(table.load());
+	copy_from(rhs);
+	return *this;
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::copy_from(const ConcurrentHashTableCollection<K,V>& rhs) {
+	rhs.lock_all_shared();
+	Table* src = rhs.table.load();
+	Table* dst = new_table(src->capacity);
+	// same capacity, so each chain copies to the same bucket
+	for (int i = 0; i < src->capacity; i++) {
+		for (Node* curr_node = src->buckets[i]; curr_node; curr_node = curr_node->next) {
+			Node* ptr = new Node;
+			ptr->key = curr_node->key;
+			ptr->value = curr_node->value;
+			ptr->next = dst->buckets[i];
+			dst->buckets[i] = ptr;
+		}
+	}
+	collection_size = rhs.collection_size.load();
+	rhs.unlock_all_shared();
+	table.store(dst);
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::lock_all_shared() const {
+	// always in stripe order, and no thread holds more than one
+	// stripe exclusively, so this cannot deadlock
+	for (int i = 0; i < stripe_count; i++)
+		stripes[i].lock.lock_shared();
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::unlock_all_shared() const {
+	for (int i = 0; i < stripe_count; i++)
+		stripes[i].lock.unlock_shared();
+}
+
+template <typename K, typename V>
+size_t ConcurrentHashTableCollection<K,V>::hash(const K& key) {
+	std::hash<K> hash_fun;
+	return hash_fun(key);
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::resize_and_rehash() {
+	// someone else is already resizing
+	std::unique_lock<std::mutex> resizing(resize_lock, std::try_to_lock);
+	if (!resizing.owns_lock())
+		return;
+	// writers are now locked out, readers can keep using the old table
+	lock_all_shared();
+	Table* old_table = table.load();
+	if (static_cast<double>(collection_size.load()) / old_table->capacity <= load_factor_threshold) {
+		unlock_all_shared();
+		return;
+	}
+	// copy the chains into the new table (the old nodes must stay intact
+	// for any reader still walking them)
+	COLLECTION_REHASH("ConcurrentHashTable");
+	Table* t = new_table(old_table->capacity * 2);
+	for (int i = 0; i < old_table->capacity; i++) {
+		for (Node* curr_node = old_table->buckets[i]; curr_node; curr_node = curr_node->next) {
+			size_t index = hash(curr_node->key) % t->capacity;
+			Node* ptr = new Node;
+			ptr->key = curr_node->key;
+			ptr->value = curr_node->value;
+			ptr->next = t->buckets[index];
+			t->buckets[index] = ptr;
+		}
+	}
+	table.store(t);
+	unlock_all_shared();
+	// readers load the table pointer while holding their stripe, so once
+	// each stripe has been held exclusively nobody can see the old table
+	for (int i = 0; i < stripe_count; i++) {
+		stripes[i].lock.lock();
+		stripes[i].lock.unlock();
+	}
+	delete_table(old_table);
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::insert(const K& key, const V& val) {
+	COLLECTION_OP("ConcurrentHashTable", OP_INSERT);
+	size_t value = hash(key);
+	bool added = false;
+	int capacity;
+	{
+		std::unique_lock<std::shared_mutex> guard(stripes[value % stripe_count].lock);
+		Table* t = table.load();
+		capacity = t->capacity;
+		size_t index = value % capacity;
+		Node* curr_node = t->buckets[index];
+		while (curr_node && !(curr_node->key == key)) {
+			COLLECTION_PROBES(1);
+			curr_node = curr_node->next;
+		}
+		if (curr_node)
+			curr_node->value = val;
+		else {
+			Node* ptr = new Node;
+			ptr->key = key;
+			ptr->value = val;
+			ptr->next = t->buckets[index];
+			t->buckets[index] = ptr;
+			added = true;
+		}
+	}
+	if (!added)
+		return;
+	// check current load factor versus load factor threshold (with the
+	// stripe unlocked, since resizing needs every stripe)
+	int new_size = ++collection_size;
+	if (static_cast<double>(new_size) / capacity > load_factor_threshold)
+		resize_and_rehash();
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::remove(const K& key) {
+	COLLECTION_OP("ConcurrentHashTable", OP_REMOVE);
+	size_t value = hash(key);
+	std::unique_lock<std::shared_mutex> guard(stripes[value % stripe_count].lock);
+	Table* t = table.load();
+	size_t index = value % t->capacity;
+	Node* curr_node = t->buckets[index];
+	Node* curr_node_previous = nullptr;
+	while (curr_node) {
+		COLLECTION_PROBES(1);
+		if (curr_node->key == key) {
+			if (!curr_node_previous)
+				t->buckets[index] = curr_node->next;
+			else
+				curr_node_previous->next = curr_node->next;
+			delete curr_node;
+			collection_size--;
+			return;
+		}
+		curr_node_previous = curr_node;
+		curr_node = curr_node->next;
+	}
+}
+
+template <typename K, typename V>
+bool ConcurrentHashTableCollection<K,V>::find(const K& key, V& val) const {
+	COLLECTION_OP("ConcurrentHashTable", OP_FIND);
+	size_t value = hash(key);
+	std::shared_lock<std::shared_mutex> guard(stripes[value % stripe_count].lock);
+	Table* t = table.load();
+	Node* curr_node = t->buckets[value % t->capacity];
+	int links = 0;
+	while (curr_node) {
+		links++;
+		if (curr_node->key == key) {
+			val = curr_node->value;
+			COLLECTION_PROBES(links);
+			COLLECTION_CHAIN("ConcurrentHashTable", links);
+			return true;
+		}
+		curr_node = curr_node->next;
+	}
+	COLLECTION_PROBES(links);
+	COLLECTION_CHAIN("ConcurrentHashTable", links);
+	return false;
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+	COLLECTION_OP("ConcurrentHashTable", OP_RANGE);
+	COLLECTION_PROBES(collection_size.load());
+	keys.clear();
+	lock_all_shared();
+	Table* t = table.load();
+	for (int i = 0; i < t->capacity; i++)
+		for (Node* curr_node = t->buckets[i]; curr_node; curr_node = curr_node->next)
+			if (curr_node->key >= k1 && curr_node->key <= k2)
+				keys.push_back(curr_node->key);
+	unlock_all_shared();
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::keys(std::vector<K>& keys) const {
+	keys.clear();
+	lock_all_shared();
+	Table* t = table.load();
+	for (int i = 0; i < t->capacity; i++)
+		for (Node* curr_node = t->buckets[i]; curr_node; curr_node = curr_node->next)
+			keys.push_back(curr_node->key);
+	unlock_all_shared();
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::sort(std::vector<K>& ks) const {
+	keys(ks);
+	std::sort(ks.begin(), ks.end());
+}
+
+template <typename K, typename V>
+int ConcurrentHashTableCollection<K,V>::size() const {
+	return collection_size.load();
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	visit(nullptr, nullptr, visitor);
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	visit(&k1, &k2, visitor);
+}
+
+template <typename K, typename V>
+void ConcurrentHashTableCollection<K,V>::visit(const K* k1, const K* k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	// writers wait until the visit is done, so the visitor must not call
+	// back into this collection to modify it
+	lock_all_shared();
+	Table* t = table.load();
+	for (int i = 0; i < t->capacity; i++) {
+		for (Node* curr_node = t->buckets[i]; curr_node; curr_node = curr_node->next) {
+			if (k1 && (*k1 > curr_node->key || *k2 < curr_node->key))
+				continue;
+			if (!visitor(curr_node->key, curr_node->value)) {
+				unlock_all_shared();
+				return;
+			}
+		}
+	}
+	unlock_all_shared();
+}
+
+#endif
@@ -0,0 +1,475 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Implementation of Collection using a lock-free skip list that
+can be shared between threads. Keys stay in order, so unlike the concurrent
+hash table it answers range finds and sort() by walking the bottom level.
+
+A node is removed by marking the low bit of its next pointers, from the top
+level down; the thread whose mark lands on the bottom level owns the
+removal. Marked nodes are unlinked by whichever thread's search passes them,
+and freed through epoch.h once unlinked from every level. find() never
+writes and never retries: it steps over marked nodes, so it finishes in a
+bounded number of steps however the writers interleave (the range finds and
+visits are weakly consistent walks of the same kind). insert() and remove()
+retry only when another thread's change got in first.
+
+A node may be removed while its inserter is still linking its upper levels.
+The inserter and the remover each set a flag in the node when done, and the
+second to finish unlinks it from every level and retires it, so it cannot be
+linked again after it was freed.
+*/
+
+#ifndef CONCURRENT_SKIPLIST_COLLECTION_H
+#define CONCURRENT_SKIPLIST_COLLECTION_H
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <cstdint>
+#include <type_traits>
+#include "collection.h"
+#include "epoch.h"
+#include "instrumentation.h"
+
+
+// a node's value, which insert() may replace while other threads read it:
+// a plain atomic when V fits in one, else a pointer to a boxed copy (the
+// replaced box is retired)
+template <typename V, bool Boxed = !(std::is_trivially_copyable<V>::value && sizeof(V) <= sizeof(void*))>
+class SkipListValue {
+public:
+	SkipListValue(const V& val): value(val) {}
+	V load() const { return value.load(std::memory_order_acquire); }
+	void store(const V& val) { value.store(val, std::memory_order_release); }
+private:
+	std::atomic<V> value;
+};
+
+template <typename V>
+class SkipListValue<V,true> {
+public:
+	SkipListValue(const V& val): box(new V(val)) {}
+	~SkipListValue() { delete box.load(); }
+	V load() const { return *box.load(std::memory_order_acquire); }
+	void store(const V& val) { epoch_retire(box.exchange(new V(val), std::memory_order_acq_rel)); }
+private:
+	std::atomic<V*> box;
+};
+
+
+template <typename K, typename V>
+class ConcurrentSkipListCollection: public Collection<K,V> {
+	public:
+		// create an empty skip list
+		ConcurrentSkipListCollection();
+
+		// copy a skip list (rhs may be in use by other threads, this
+		// object may not)
+		ConcurrentSkipListCollection(const ConcurrentSkipListCollection<K,V>& rhs);
+
+		// assign a skip list (rhs may be in use by other threads, this
+		// object may not)
+		ConcurrentSkipListCollection<K,V>& operator =(const ConcurrentSkipListCollection<K,V>& rhs);
+
+		// delete a skip list
+		~ConcurrentSkipListCollection();
+
+		// insert a key-value pair into the collection (replaces the
+		// value if the key is already present)
+		void insert(const K& key, const V& val);
+
+		// remove a key-value pair from the collection
+		void remove(const K& key);
+
+		// find the value associated with the key
+		bool find(const K& key, V& val) const;
+
+		// find the keys associated with the range
+		void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+		// return all keys in the collection
+		void keys(std::vector<K>& keys) const;
+
+		// return collection keys in sorted order
+		void sort(std::vector<K>& keys) const;
+
+		// return the number of keys in collection
+		int size() const;
+
+		// call visitor on each key-value pair in key order until it
+		// returns false
+		void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// call visitor on each key-value pair with k1 <= key <= k2 in key
+		// order until it returns false
+		void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	private:
+		// skip list node, followed in memory by its height next links
+		// (each a Node* whose low bit marks this node removed)
+		struct alignas(std::atomic<uintptr_t>) Node {
+			K key;
+			SkipListValue<V> value;
+			// LINKED and REMOVED flags
+			std::atomic<int> state;
+			int height;
+
+			Node(const K& key, const V& val, int height): key(key), value(val), state(0), height(height) {}
+
+			std::atomic<uintptr_t>* next() { return reinterpret_cast<std::atomic<uintptr_t>*>(this + 1); }
+		};
+
+		// node state flags: the inserter has finished linking the node,
+		// the remover has finished marking it
+		enum NodeState {LINKED = 1, REMOVED = 2};
+
+		// levels in the list (a node reaches level i with probability
+		// 4^-i, so this covers 4^16 keys)
+		static const int max_height = 16;
+
+		// allocate a node with unlinked next links
+		static Node* new_node(const K& key, const V& val, int height);
+
+		// free a node (as an epoch_retire() deleter)
+		static void delete_node(void* node);
+
+		// the node a link points to, and whether it is marked
+		static Node* target(uintptr_t link) { return reinterpret_cast<Node*>(link & ~uintptr_t(1)); }
+		static bool marked(uintptr_t link) { return link & 1; }
+
+		// pick the height of a new node
+		static int random_height();
+
+		// fill preds and succs with the last node before key and the
+		// first node at or after it on each level, unlinking the marked
+		// nodes on the way, and return whether succs[0] holds key
+		bool search(const K& key, Node** preds, Node** succs);
+
+		// return the first unmarked node at or after key, without
+		// writing anything (nullptr if there is none)
+		Node* first_at_least(const K& key) const;
+
+		// return the first unmarked node after curr on the bottom level
+		static Node* next_unmarked(Node* curr);
+
+		// free every node (no other thread may be using the list)
+		void clear();
+
+		// copy every key-value pair of rhs into this (empty) object
+		void copy_from(const ConcurrentSkipListCollection<K,V>& rhs);
+
+	// number of k-v pairs in the collection
+	std::atomic<int> collection_size;
+
+	// sentinel before the first node, as tall as the list can get
+	Node* head;
+};
+
+
+template <typename K, typename V>
+ConcurrentSkipListCollection<K,V>::ConcurrentSkipListCollection(): collection_size(0),
+	head(new_node(K(), V(), max_height)) {}
+
+template <typename K, typename V>
+ConcurrentSkipListCollection<K,V>::ConcurrentSkipListCollection(const ConcurrentSkipListCollection<K,V>& rhs):
+	collection_size(0), head(new_node(K(), V(), max_height)) {
+	copy_from(rhs);
+}
+
+template <typename K, typename V>
+ConcurrentSkipListCollection<K,V>& ConcurrentSkipListCollection<K,V>::operator=(const ConcurrentSkipListCollection<K,V>& rhs) {
+	// check if rhs is current object and return current object
+	if (this == &rhs)
+		return *this;
+	clear();
+	copy_from(rhs);
+	return *this;
+}
+
+template <typename K, typename V>
+ConcurrentSkipListCollection<K,V>::~ConcurrentSkipListCollection() {
+	clear();
+	delete_node(head);
+}
+
+template <typename K, typename V>
+typename ConcurrentSkipListCollection<K,V>::Node* ConcurrentSkipListCollection<K,V>::new_node(const K& key, const V& val,
+	int height) {
+	void* memory = ::operator new(sizeof(Node) + height * sizeof(std::atomic<uintptr_t>));
+	Node* node = new (memory) Node(key, val, height);
+	for (int i = 0; i < height; i++)
+		new (&node->next()[i]) std::atomic<uintptr_t>(0);
+	return node;
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::delete_node(void* node) {
+	Node* n = static_cast<Node*>(node);
+	n->~Node();
+	::operator delete(n);
+}
+
+template <typename K, typename V>
+int ConcurrentSkipListCollection<K,V>::random_height() {
+	// xorshift, seeded per thread from the address of its state
+	static thread_local uint64_t state = reinterpret_cast<uintptr_t>(&state) | 1;
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	// each pair of trailing zero bits is one more level
+	int height = 1 + __builtin_ctzll(state | (uint64_t(1) << 62)) / 2;
+	return height < max_height ? height : max_height;
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::clear() {
+	Node* curr_node = target(head->next()[0].load());
+	while (curr_node) {
+		Node* previous = curr_node;
+		curr_node = target(curr_node->next()[0].load());
+		delete_node(previous);
+	}
+	for (int i = 0; i < max_height; i++)
+		head->next()[i].store(0);
+	collection_size = 0;
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::copy_from(const ConcurrentSkipListCollection<K,V>& rhs) {
+	// rhs is walked in key order, so each node goes after the last one
+	// on its levels
+	Node* last[max_height];
+	for (int i = 0; i < max_height; i++)
+		last[i] = head;
+	int copied = 0;
+	EpochGuard guard;
+	for (Node* curr_node = next_unmarked(rhs.head); curr_node; curr_node = next_unmarked(curr_node)) {
+		Node* node = new_node(curr_node->key, curr_node->value.load(), random_height());
+		for (int i = 0; i < node->height; i++) {
+			last[i]->next()[i].store(reinterpret_cast<uintptr_t>(node));
+			last[i] = node;
+		}
+		node->state = LINKED;
+		copied++;
+	}
+	collection_size = copied;
+}
+
+template <typename K, typename V>
+bool ConcurrentSkipListCollection<K,V>::search(const K& key, Node** preds, Node** succs) {
+	for (;;) {
+		bool retry = false;
+		Node* pred = head;
+		Node* curr = nullptr;
+		for (int level = max_height - 1; level >= 0 && !retry; level--) {
+			curr = target(pred->next()[level].load(std::memory_order_acquire));
+			while (curr) {
+				COLLECTION_PROBES(1);
+				uintptr_t succ = curr->next()[level].load(std::memory_order_acquire);
+				if (marked(succ)) {
+					// unlink curr on this level (start over if pred changed,
+					// since pred may have been removed itself)
+					uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+					if (!pred->next()[level].compare_exchange_strong(expected, succ & ~uintptr_t(1),
+						std::memory_order_acq_rel)) {
+						retry = true;
+						break;
+					}
+					curr = target(succ);
+					continue;
+				}
+				if (!(curr->key < key))
+					break;
+				pred = curr;
+				curr = target(succ);
+			}
+			preds[level] = pred;
+			succs[level] = curr;
+		}
+		if (!retry)
+			return curr && curr->key == key;
+	}
+}
+
+template <typename K, typename V>
+typename ConcurrentSkipListCollection<K,V>::Node* ConcurrentSkipListCollection<K,V>::first_at_least(const K& key) const {
+	Node* pred = head;
+	Node* curr = nullptr;
+	for (int level = max_height - 1; level >= 0; level--) {
+		curr = target(pred->next()[level].load(std::memory_order_acquire));
+		while (curr) {
+			COLLECTION_PROBES(1);
+			uintptr_t succ = curr->next()[level].load(std::memory_order_acquire);
+			// step over marked nodes (their links still lead forward)
+			if (!marked(succ)) {
+				if (!(curr->key < key))
+					break;
+				pred = curr;
+			}
+			curr = target(succ);
+		}
+	}
+	return curr;
+}
+
+template <typename K, typename V>
+typename ConcurrentSkipListCollection<K,V>::Node* ConcurrentSkipListCollection<K,V>::next_unmarked(Node* curr) {
+	curr = target(curr->next()[0].load(std::memory_order_acquire));
+	while (curr) {
+		uintptr_t succ = curr->next()[0].load(std::memory_order_acquire);
+		if (!marked(succ))
+			return curr;
+		curr = target(succ);
+	}
+	return nullptr;
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::insert(const K& key, const V& val) {
+	COLLECTION_OP("ConcurrentSkipList", OP_INSERT);
+	EpochGuard guard;
+	Node* preds[max_height];
+	Node* succs[max_height];
+	Node* node = nullptr;
+	// link the node on the bottom level, which puts it in the collection
+	for (;;) {
+		if (search(key, preds, succs)) {
+			succs[0]->value.store(val);
+			// never seen by another thread
+			if (node)
+				delete_node(node);
+			return;
+		}
+		if (!node)
+			node = new_node(key, val, random_height());
+		for (int i = 0; i < node->height; i++)
+			node->next()[i].store(reinterpret_cast<uintptr_t>(succs[i]), std::memory_order_relaxed);
+		uintptr_t expected = reinterpret_cast<uintptr_t>(succs[0]);
+		if (preds[0]->next()[0].compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+			std::memory_order_release))
+			break;
+	}
+	collection_size++;
+	// link the upper levels, stopping if the node is being removed
+	for (int i = 1; i < node->height; i++) {
+		bool linked = false;
+		for (;;) {
+			uintptr_t expected = reinterpret_cast<uintptr_t>(succs[i]);
+			if (preds[i]->next()[i].compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node),
+				std::memory_order_release)) {
+				linked = true;
+				break;
+			}
+			// a node went in or out next to it: look again, and point the
+			// node at its new successor unless a remover marked it
+			search(key, preds, succs);
+			if (succs[0] != node)
+				break;
+			uintptr_t link = node->next()[i].load(std::memory_order_acquire);
+			if (marked(link) || !node->next()[i].compare_exchange_strong(link, reinterpret_cast<uintptr_t>(succs[i])))
+				break;
+		}
+		if (!linked)
+			break;
+	}
+	// a remover that finished first left the node for this thread to
+	// unlink and retire
+	if (node->state.fetch_or(LINKED) & REMOVED) {
+		search(key, preds, succs);
+		epoch_retire(node, delete_node);
+	}
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::remove(const K& key) {
+	COLLECTION_OP("ConcurrentSkipList", OP_REMOVE);
+	EpochGuard guard;
+	Node* preds[max_height];
+	Node* succs[max_height];
+	if (!search(key, preds, succs))
+		return;
+	Node* node = succs[0];
+	// mark the upper levels, then the bottom one, which removes it
+	for (int i = node->height - 1; i >= 1; i--) {
+		uintptr_t link = node->next()[i].load(std::memory_order_acquire);
+		while (!marked(link))
+			node->next()[i].compare_exchange_weak(link, link | 1, std::memory_order_acq_rel);
+	}
+	uintptr_t link = node->next()[0].load(std::memory_order_acquire);
+	for (;;) {
+		// another thread removed it first
+		if (marked(link))
+			return;
+		if (node->next()[0].compare_exchange_weak(link, link | 1, std::memory_order_acq_rel))
+			break;
+	}
+	collection_size--;
+	// unless its inserter is still linking it, unlink it everywhere (the
+	// search unlinks every marked node it passes) and retire it
+	if (node->state.fetch_or(REMOVED) & LINKED) {
+		search(key, preds, succs);
+		epoch_retire(node, delete_node);
+	}
+}
+
+template <typename K, typename V>
+bool ConcurrentSkipListCollection<K,V>::find(const K& key, V& val) const {
+	COLLECTION_OP("ConcurrentSkipList", OP_FIND);
+	EpochGuard guard;
+	Node* node = first_at_least(key);
+	if (!node || !(node->key == key))
+		return false;
+	val = node->value.load();
+	return true;
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+	COLLECTION_OP("ConcurrentSkipList", OP_RANGE);
+	keys.clear();
+	EpochGuard guard;
+	for (Node* curr_node = first_at_least(k1); curr_node && !(k2 < curr_node->key); curr_node = next_unmarked(curr_node)) {
+		COLLECTION_PROBES(1);
+		keys.push_back(curr_node->key);
+	}
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::keys(std::vector<K>& keys) const {
+	keys.clear();
+	EpochGuard guard;
+	for (Node* curr_node = next_unmarked(head); curr_node; curr_node = next_unmarked(curr_node))
+		keys.push_back(curr_node->key);
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::sort(std::vector<K>& ks) const {
+	// the bottom level is already in key order
+	keys(ks);
+}
+
+template <typename K, typename V>
+int ConcurrentSkipListCollection<K,V>::size() const {
+	return collection_size.load();
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	// the visitor may call back into the collection
+	EpochGuard guard;
+	for (Node* curr_node = next_unmarked(head); curr_node; curr_node = next_unmarked(curr_node))
+		if (!visitor(curr_node->key, curr_node->value.load()))
+			return;
+}
+
+template <typename K, typename V>
+void ConcurrentSkipListCollection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	EpochGuard guard;
+	for (Node* curr_node = first_at_least(k1); curr_node && !(k2 < curr_node->key); curr_node = next_unmarked(curr_node))
+		if (!visitor(curr_node->key, curr_node->value.load()))
+			return;
+}
+
+#endif
@@ -1,7 +1,9 @@
 /*
 Greeley Lindberg
 12/11/19, hw11
-Description: Implementation of Collection using a red black tree.
+Description: Implementation of Collection using a red black tree. Each
+node also keeps the size of its subtree, so rank(), select(), count() and
+the paged find() and sort() take O(log n) time (plus the page).
 */
 
 #ifndef DBL_RBT_COLLECTION_H
@@ -9,10 +11,17 @@ Description: Implementation of Collection using a red black tree.
 
 #include <vector>
 #include <algorithm>
+#include <utility>
+#include <type_traits>
 #include "collection.h"
+#include "bulk_load.h"
+#include "node_allocator.h"
+#include "tree_traversal.h"
+#include "tree_stats.h"
+#include "instrumentation.h"
 
 
-template <typename K, typename V>
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool>
 class RBTCollection : public Collection<K,V> {
 public:
 
@@ -20,10 +29,16 @@ public:
 	RBTCollection();
 
 	// copy a linked list
-	RBTCollection(const RBTCollection<K,V>& rhs);
+	RBTCollection(const RBTCollection<K,V,NodeAlloc>& rhs);
 
 	// assign a linked list
-	RBTCollection<K,V>& operator =(const RBTCollection<K,V>& rhs);
+	RBTCollection<K,V,NodeAlloc>& operator =(const RBTCollection<K,V,NodeAlloc>& rhs);
+
+	// move a red-black tree (rhs is left empty)
+	RBTCollection(RBTCollection<K,V,NodeAlloc>&& rhs) noexcept;
+
+	// move assign a red-black tree (rhs is left empty)
+	RBTCollection<K,V,NodeAlloc>& operator =(RBTCollection<K,V,NodeAlloc>&& rhs) noexcept;
 
 	// delete a linked list
 	~RBTCollection();
@@ -31,6 +46,14 @@ public:
 	// insert a key-value pair into the collection
 	void insert(const K& key, const V& val);
 
+	// insert a key-value pair, moving the key and value into the collection
+	void insert(K&& key, V&& val);
+
+	// insert a key-value pair with the key forwarded from key and the value
+	// constructed in place from args
+	template <typename KArg, typename... Args>
+	void emplace(KArg&& key, Args&&... args);
+
 	// remove a key-value pair from the collection
 	void remove(const K& key);
 
@@ -40,18 +63,64 @@ public:
 	// find the keys associated with the range
 	void find(const K& k1, const K& k2, std::vector <K>& keys) const;
 
+	// find the values of keys[0..n-1], walking a group of the searches down
+	// the tree together
+	void find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const;
+
 	// return all keys in the collection
 	void keys(std::vector <K>& keys) const;
 
 	// return collection keys in sorted order
 	void sort(std::vector <K>& keys) const;
 
+	// keys(), sort() and find(k1, k2, keys) with the subtrees walked on pool
+	void parallel_keys(std::vector <K>& keys, ThreadPool& pool) const;
+	void parallel_sort(std::vector <K>& keys, ThreadPool& pool) const;
+	void parallel_find(const K& k1, const K& k2, std::vector <K>& keys, ThreadPool& pool) const;
+
 	// return the number of keys in collection
 	int size() const;
 
-	// return the height of the tree
+	// call visitor on each key-value pair in ascending key order until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2 in ascending key order
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// replace the contents with the key-value pairs in [begin, end) (linear
+	// time when the keys are already ascending)
+	template <typename Iter>
+	void bulk_load(Iter begin, Iter end);
+
+	// return the height of the tree (walks every node; stats() has the
+	// cheap max_depth)
 	int height() const;
 
+	// return the structural stats, in O(1) time
+	TreeStats stats() const;
+
+	// restart the stats that count since the last reset
+	void reset_stats();
+
+	// return the number of keys < key
+	int rank(const K& key) const;
+
+	// set key and val to the pair at position i of the sorted order and
+	// return true, or return false if i is not in 0..size()-1
+	bool select(int i, K& key, V& val) const;
+
+	// return the number of keys >= k1 and <= k2
+	int count(const K& k1, const K& k2) const;
+
+	// find the page of at most limit keys >= k1 and <= k2 that starts
+	// offset keys into the range
+	void find(const K& k1, const K& k2, int offset, int limit, std::vector <K>& keys) const;
+
+	// return the page of at most limit keys in sorted order starting at
+	// position offset
+	void sort(int offset, int limit, std::vector <K>& keys) const;
+
 	// print for testing
 	void print() const;
 
@@ -59,10 +128,18 @@ private:
 
 	// binary search tree node structure
 	struct Node {
+		// construct the key from k and the value from args
+		template <typename KArg, typename... Args>
+		Node(std::piecewise_construct_t, KArg&& k, Args&&... args): key(std::forward<KArg>(k)),
+			value(std::forward<Args>(args)...) {}
+		Node() {}
+
 		K key;
 		V value;
 		Node* left;
 		Node* right;
+		// number of nodes in the subtree rooted here
+		int count;
 		bool is_black;
 		bool is_dbl_black_left;
 		bool is_dbl_black_right;
@@ -74,17 +151,42 @@ private:
 	// number of k-v pairs in the collection
 	int collection_size;
 
-	// helper to recursively empty search tree
+	// allocator for the tree nodes
+	NodeAlloc<Node> nodes;
+
+	// structural stats (nodes is filled in by stats())
+	TreeStats tree_stats;
+
+	// helper to empty the search tree
+	void make_empty();
+
+	// helper to empty search tree (iteratively)
 	void make_empty(Node* subtree_root);
 
+	// helper to copy subtree node for node (iteratively)
+	Node* copy(const Node* subtree_root);
+
 	// recursive helper to remove node with given key
 	Node* remove(const K& key, Node* parent, Node* subtree_root, bool& found);
 
 	// helper to perform a single rebalance step on a red-black tree on remove
 	Node* remove_color_adjust(Node* parent);
 
-	// recursive helper to do red-black insert key-val pair (backtracking)
-	Node* insert(const K& key, const V& val, Node* subtree_root);
+	// recursive helper to do red-black insert of new node ptr (backtracking;
+	// subtree_root is at depth, counting the root as 1)
+	Node* insert(Node* ptr, Node* subtree_root, int depth);
+
+	// helpers to read (0 for an empty subtree) and recompute from the
+	// children the subtree size of a node
+	static int count_of(const Node* subtree_root);
+	static void update_count(Node* subtree_root);
+
+	// return the number of keys < key, or <= key if or_equal
+	int rank(const K& key, bool or_equal) const;
+
+	// helper to append up to limit keys, from position i of the sorted
+	// order on, stopping at the first key > *k2 (if k2 is given)
+	void collect_from(int i, const K* k2, int limit, std::vector <K>& keys) const;
 
 	// helper function to perform a single right rotation
 	Node* rotate_right(Node* k2);
@@ -92,114 +194,174 @@ private:
 	// helper fuction to perform single left rotation
 	Node* rotate_left(Node* k2);
 
-	// helper to recursively build sorted list of keys
+	// helper to build sorted list of keys (iteratively)
 	void inorder(const Node* subtree, std::vector <K>& keys) const;
 
-	// helper to recursively build sorted list of keys
+	// helper to build list of keys in preorder (iteratively)
 	void preorder(const Node* subtree, std::vector <K>& keys) const;
 
 	// helper to recursively print
 	void print(Node* subtree_root) const;
 
-	// helper to recursively find range of keys
+	// helper to find range of keys in ascending order (iteratively)
 	void range_search(const Node* subtree, const K& k1, const K& k2,
 	std::vector <K>& keys) const;
 
+	// helper to visit subtree in order (returns false once the visitor
+	// stops)
+	bool inorder(const Node* subtree, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// helper to visit the keys of subtree in range in order (returns
+	// false once the visitor stops)
+	bool range_search(const Node* subtree, const K& k1, const K& k2,
+	const std::function<bool(const K&, const V&)>& visitor) const;
+
 	// helper to reursively remove key node from subtree
 	Node* remove(const K& key, Node* subtree_root);
 
 	// return the height of the tree rooted at subtree_root
 	int height(const Node* subtree_root) const;
 
+	// helper to build a balanced subtree from the next n pairs at it
+	// (nodes at red_depth are red, all others black)
+	template <typename Iter>
+	Node* build(Iter& it, int n, int depth, int red_depth);
+
 };
 
 
-template <typename K, typename V>
-RBTCollection<K,V>::RBTCollection(): collection_size (0), root(nullptr) {}
+template <typename K, typename V, template <typename> class NodeAlloc>
+RBTCollection<K,V,NodeAlloc>::RBTCollection(): collection_size (0), root(nullptr), tree_stats(empty_tree_stats()) {}
 
 
-template <typename K, typename V>
-void RBTCollection<K,V>::make_empty(Node* subtree_root) {
-	if (!subtree_root)
-		return;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::make_empty(Node* subtree_root) {
+	destroy_nodes(subtree_root, [this](Node* ptr) { nodes.destroy(ptr); });
+}
 
-	make_empty(subtree_root->left);
-	make_empty(subtree_root->right);
-	delete subtree_root;
-	collection_size--;
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::make_empty() {
+	// a pool frees all the nodes at once, so they only need to be
+	// visited if they have destructors to run
+	if (!NodeAlloc<Node>::bulk_release || !std::is_trivially_destructible<Node>::value)
+		make_empty(root);
+	nodes.release();
+	root = nullptr;
+	collection_size = 0;
+	tree_stats.black_height = 0;
 }
 
 
-template <typename K, typename V>
-RBTCollection<K,V>::~RBTCollection() {
-	make_empty(root);
+template <typename K, typename V, template <typename> class NodeAlloc>
+RBTCollection<K,V,NodeAlloc>::~RBTCollection() {
+	make_empty();
 }
 
 
-template <typename K, typename V>
-RBTCollection<K,V>::RBTCollection(const RBTCollection<K,V>& rhs): collection_size (0), root(nullptr) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+RBTCollection<K,V,NodeAlloc>::RBTCollection(const RBTCollection<K,V,NodeAlloc>& rhs): collection_size (0), root(nullptr), tree_stats(empty_tree_stats()) {
 	*this = rhs;
 }
 
 
-template <typename K, typename V>
-RBTCollection<K,V>& RBTCollection<K,V>::operator =(const RBTCollection<K,V>& rhs) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+RBTCollection<K,V,NodeAlloc>& RBTCollection<K,V,NodeAlloc>::operator =(const RBTCollection<K,V,NodeAlloc>& rhs) {
 	if (this == &rhs)
 		return *this;
 	// delete current
-	make_empty(root);
-	root = nullptr;
-	// build tree
-	std::vector <K> ks;
-	preorder(rhs.root, ks);
-	V val;
-	for (int i = 0; i < ks.size(); i++) {
-		rhs.find(ks[i], val);
-		insert(ks[i], val);
-	}
+	make_empty();
+	// copy node for node (colors included) instead of reinserting
+	root = copy(rhs.root);
+	collection_size = rhs.collection_size;
+	tree_stats = rhs.tree_stats;
 
 	return *this;
 }
 
-template <typename K, typename V>
-typename RBTCollection<K,V>::Node* RBTCollection<K,V>::rotate_right(Node* k2) {
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+RBTCollection<K,V,NodeAlloc>::RBTCollection(RBTCollection<K,V,NodeAlloc>&& rhs) noexcept: root(nullptr), collection_size (0), tree_stats(empty_tree_stats()) {
+	*this = std::move(rhs);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+RBTCollection<K,V,NodeAlloc>& RBTCollection<K,V,NodeAlloc>::operator =(RBTCollection<K,V,NodeAlloc>&& rhs) noexcept {
+	if (this == &rhs)
+		return *this;
+	// take over rhs's nodes and leave it with this (now empty) tree
+	make_empty();
+	std::swap(root, rhs.root);
+	std::swap(collection_size, rhs.collection_size);
+	std::swap(tree_stats, rhs.tree_stats);
+	nodes.swap(rhs.nodes);
+
+	return *this;
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename RBTCollection<K,V,NodeAlloc>::Node* RBTCollection<K,V,NodeAlloc>::copy(const Node* subtree_root) {
+	return clone_nodes(subtree_root, [this]() { return nodes.create(); });
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename RBTCollection<K,V,NodeAlloc>::Node* RBTCollection<K,V,NodeAlloc>::rotate_right(Node* k2) {
+	tree_stats.rotations++;
 	Node* k1 = k2->left;
 	k2->left = k1->right;
 	k1->right = k2;
+	update_count(k2);
+	update_count(k1);
 	return k1;
 }
 
-template <typename K, typename V>
-typename RBTCollection<K,V>::Node* RBTCollection<K,V>::rotate_left(Node* k2) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename RBTCollection<K,V,NodeAlloc>::Node* RBTCollection<K,V,NodeAlloc>::rotate_left(Node* k2) {
+	tree_stats.rotations++;
 	Node* k1 = k2->right;
 	k2->right = k1->left;
 	k1->left = k2;
+	update_count(k2);
+	update_count(k1);
 	return k1;
 }
 
-template <typename K, typename V>
-typename RBTCollection<K,V>::Node*
-RBTCollection<K,V>::insert(const K& key, const V& val, Node* subtree_root) {
-	Node* ptr = new Node;
-	ptr->key = key;
-	ptr->value = val;
-	ptr->left = nullptr;
-	ptr->right = nullptr;
-	ptr->is_black = false;
-	ptr->is_dbl_black_left = false;
-	ptr->is_dbl_black_right = false;
-	 if (!root) 
-	 	return ptr;
-	if (key < subtree_root->key) 
-		if (!subtree_root->left)
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::count_of(const Node* subtree_root) {
+	return subtree_root ? subtree_root->count : 0;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::update_count(Node* subtree_root) {
+	subtree_root->count = 1 + count_of(subtree_root->left) + count_of(subtree_root->right);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename RBTCollection<K,V,NodeAlloc>::Node*
+RBTCollection<K,V,NodeAlloc>::insert(Node* ptr, Node* subtree_root, int depth) {
+	if (!root) {
+		tree_stats.max_depth = std::max(tree_stats.max_depth, 1);
+		return ptr;
+	}
+	COLLECTION_PROBES(1);
+	if (ptr->key < subtree_root->key)
+		if (!subtree_root->left) {
 			subtree_root->left = ptr;
+			tree_stats.max_depth = std::max(tree_stats.max_depth, depth + 1);
+		}
 		else
-			subtree_root->left = insert(key, val, subtree_root->left);
+			subtree_root->left = insert(ptr, subtree_root->left, depth + 1);
 	else
-		if (!subtree_root->right)
+		if (!subtree_root->right) {
 			subtree_root->right = ptr;
+			tree_stats.max_depth = std::max(tree_stats.max_depth, depth + 1);
+		}
 		else
-			subtree_root->right = insert(key, val, subtree_root->right);
+			subtree_root->right = insert(ptr, subtree_root->right, depth + 1);
+	// the new node is below (any rotation here recounts the nodes it moves)
+	subtree_root->count++;
 
 	// check if subtree_root is a grandparent
 	if ((subtree_root->left && (subtree_root->left->left || subtree_root->left->right)) ||
@@ -249,11 +411,13 @@ RBTCollection<K,V>::insert(const K& key, const V& val, Node* subtree_root) {
 		// case 2: the sibling is black and the child is "outside"
 		else if (subtree_root->left == parent && parent->left == child) {
 			subtree_root = rotate_right(subtree_root);
+			subtree_root->is_black = true;
 			subtree_root->right->is_black = false;
 			subtree_root->left->is_black = false;
 		}
 		else if (subtree_root->right == parent && parent->right == child) {
 			subtree_root = rotate_left(subtree_root);
+			subtree_root->is_black = true;
 			subtree_root->right->is_black = false;
 			subtree_root->left->is_black = false;
 		}
@@ -277,23 +441,47 @@ RBTCollection<K,V>::insert(const K& key, const V& val, Node* subtree_root) {
 }
 
 
-template <typename K, typename V>
-void RBTCollection<K,V>::insert(const K& key, const V& val) {
-	root = insert(key, val, root);
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::insert(const K& key, const V& val) {
+	emplace(key, val);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::insert(K&& key, V&& val) {
+	emplace(std::move(key), std::move(val));
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename KArg, typename... Args>
+void RBTCollection<K,V,NodeAlloc>::emplace(KArg&& key, Args&&... args) {
+	COLLECTION_OP("RBT", OP_INSERT);
+	Node* ptr = nodes.create(std::piecewise_construct, std::forward<KArg>(key), std::forward<Args>(args)...);
+	ptr->left = nullptr;
+	ptr->right = nullptr;
+	ptr->count = 1;
+	ptr->is_black = false;
+	ptr->is_dbl_black_left = false;
+	ptr->is_dbl_black_right = false;
+	root = insert(ptr, root, 1);
+	// blackening a red root adds a black level to every path
+	if (!root->is_black)
+		tree_stats.black_height++;
 	root->is_black = true;
 	collection_size++;
 }
 
-template <typename K, typename V>
-void RBTCollection <K,V>::remove(const K& key) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::remove(const K& key) {
+	COLLECTION_OP("RBT", OP_REMOVE);
 	// check if anything to remove
 	if (root == nullptr)
 		return;
 	// create a "fake" root to pass in as parent of root
-	Node* root_parent = new Node;
+	Node* root_parent = nodes.create();
 	root_parent->key = root->key;
 	root_parent->left = nullptr;
 	root_parent->right = root;
+	root_parent->count = 0;
 	root_parent->is_black = true;
 	root_parent->is_dbl_black_left = false;
 	root_parent->is_dbl_black_right = false;
@@ -303,6 +491,10 @@ void RBTCollection <K,V>::remove(const K& key) {
 	// update results
 	if (found) {
 		collection_size--;
+		// a double black left at the fake root took a black level off
+		// every path
+		if (root_parent->is_dbl_black_right)
+			tree_stats.black_height--;
 		root = root_parent->right;
 
 		if (root) {
@@ -311,13 +503,14 @@ void RBTCollection <K,V>::remove(const K& key) {
 			root->is_dbl_black_left = false;
 		}
 	}
-	delete root_parent;
+	nodes.destroy(root_parent);
 }
 
 
-template <typename K, typename V>
-typename RBTCollection <K,V>::Node*
-RBTCollection <K,V>::remove(const K& key, Node* parent, Node* subtree_root, bool& found) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename RBTCollection<K,V,NodeAlloc>::Node*
+RBTCollection<K,V,NodeAlloc>::remove(const K& key, Node* parent, Node* subtree_root, bool& found) {
+	COLLECTION_PROBES(1);
 	if (subtree_root && key < subtree_root->key)
 		subtree_root = remove(key, subtree_root, subtree_root->left, found);
 	else if (subtree_root && key > subtree_root->key)
@@ -328,55 +521,46 @@ RBTCollection <K,V>::remove(const K& key, Node* parent, Node* subtree_root, bool
 		if (!subtree_root->left && !subtree_root->right) {
 			// if node is black then set double-black, adjust parent,
 			// and delete subtree root ...
-			if (parent->left && parent->left->key == subtree_root->key && subtree_root->is_black) {
+			// (compare the nodes, not the keys, which may repeat)
+			if (parent->left == subtree_root && subtree_root->is_black) {
 				parent->is_dbl_black_left = true;
 				parent->left = nullptr;
 			}
-			else if (parent->right && parent->right->key == subtree_root->key && subtree_root->is_black) {
+			else if (parent->right == subtree_root && subtree_root->is_black) {
 				parent->is_dbl_black_right = true;
 				parent->right = nullptr;
 			}
 			//if node is red
 			else {	
-				if (parent->right && parent->right->key == subtree_root->key)
+				if (parent->right == subtree_root)
 					parent->right = nullptr;
 				else
 					parent->left = nullptr;
 			}
-			delete subtree_root;
+			nodes.destroy(subtree_root);
+			subtree_root = nullptr;
 		}
 		// left non-empty but right empty
 		else if (subtree_root->left && !subtree_root->right) {
-			// similar to above
+			// the only child must be red, so making it black keeps the
+			// black height (no double black)
 			subtree_root->left->is_black = true;
-			if (parent->left && parent->left->key == subtree_root->key) {
-				if (subtree_root->is_black)
-					parent->is_dbl_black_left = true;
+			if (parent->left == subtree_root)
 				parent->left = subtree_root->left;
-			}
-			else if (parent->right && parent->right->key == subtree_root->key) {
-				if (subtree_root->is_black)
-					parent->is_dbl_black_right = true;
+			else
 				parent->right = subtree_root->left;
-			}
-			delete subtree_root;
+			nodes.destroy(subtree_root);
 			subtree_root = nullptr;
 		}
 		// left empty but right non-empty
 		else if (!subtree_root->left && subtree_root->right) {
 			// similar to above
 			subtree_root->right->is_black = true;
-			if (parent->left && parent->left->key == subtree_root->key) {
-				if (subtree_root->is_black)
-					parent->is_dbl_black_left = true;
-				parent->left = subtree_root->left;
-			}
-			else if (parent->right && parent->right->key == subtree_root->key) {
-				if (subtree_root->is_black)
-					parent->is_dbl_black_right = true;
+			if (parent->left == subtree_root)
+				parent->left = subtree_root->right;
+			else
 				parent->right = subtree_root->right;
-			}
-			delete subtree_root;
+			nodes.destroy(subtree_root);
 			subtree_root = nullptr;
 		}
 		// left and right non empty
@@ -396,14 +580,19 @@ RBTCollection <K,V>::remove(const K& key, Node* parent, Node* subtree_root, bool
 	if (!found)
 		return parent;
 
+	// the node is gone from below subtree_root (whose children are
+	// recounted by now), so recount it before any rotation at the parent
+	if (subtree_root)
+		update_count(subtree_root);
+
 	// backtracking, adjust color at parent
 	return remove_color_adjust(parent);
 }
 
 
-template <typename K, typename V>
-typename RBTCollection <K,V>::Node*
-RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+typename RBTCollection<K,V,NodeAlloc>::Node*
+RBTCollection<K,V,NodeAlloc>::remove_color_adjust(Node* subtree_root) {
 	// subtree root is "grandparent" g, with left child gl and right child gr
 	Node* g = subtree_root;
 	Node* gl = g->left;
@@ -424,13 +613,15 @@ RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
 		// do the following cases
 		// case 1: red sibling
 		if (p->right && !p->right->is_black) {
+			tree_stats.remove_cases[REMOVE_CASE_1]++;
 			p = rotate_left(p);
 			p->left->is_black = false;
 			p->is_black = true;
-			p->left = remove_color_adjust(p->left);
+			p = remove_color_adjust(p);
 		}
 		// case 2-a: black sibling with red child (outside)
 		else if (p->right && p->right->is_black && (p->right->right && !p->right->right->is_black)) {
+			tree_stats.remove_cases[REMOVE_CASE_2A]++;
 			p = rotate_left(p);
 			p->is_black = p->left->is_black;
 			p->left->is_black = true;
@@ -439,6 +630,7 @@ RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
 		}
 		// case 2-b: black sibling with red child (inside)
 		else if (p->right && p->right->is_black && (p->right->left && !p->right->left->is_black)) {
+			tree_stats.remove_cases[REMOVE_CASE_2B]++;
 			p->right = rotate_right(p->right);
 			p = rotate_left(p);
 			p->is_black = p->left->is_black;
@@ -447,12 +639,14 @@ RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
 		}
 		// case 3-a: black sibling with black children, red parent
 		else if (p->right && p->right->is_black && !p->is_black) {
+			tree_stats.remove_cases[REMOVE_CASE_3A]++;
 			p->is_black = true;
 			p->is_dbl_black_left = false;
 			p->right->is_black = false;
 		}
 		// case 3-b: black sibling with black children, black parent
 		else if (p->right && p->right->is_black && p->is_black) {
+			tree_stats.remove_cases[REMOVE_CASE_3B]++;
 			p->is_dbl_black_left = false;
 			if (left_parent)
 				g->is_dbl_black_left = true;
@@ -467,13 +661,15 @@ RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
 		// do the following cases
 		// case 1: red sibling
 		if (p->left && !p->left->is_black) {
+			tree_stats.remove_cases[REMOVE_CASE_1]++;
 			p = rotate_right(p);
 			p->right->is_black = false;
 			p->is_black = true;
-			p->right = remove_color_adjust(p->right);
+			p = remove_color_adjust(p);
 		}
 		// case 2-a: black sibling with red child (outside)
 		else if (p->left && p->left->is_black && (p->left->left && !p->left->left->is_black)){
+			tree_stats.remove_cases[REMOVE_CASE_2A]++;
 			p = rotate_right(p);
 			p->is_black = p->right->is_black;
 			p->right->is_black = true;
@@ -482,20 +678,23 @@ RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
 		}
 		// case 2-b: black sibling with red child (inside)
 		else if (p->left && p->left->is_black && (p->left->right && !p->left->right->is_black)){
+			tree_stats.remove_cases[REMOVE_CASE_2B]++;
 			p->left = rotate_left(p->left);
 			p = rotate_right(p);
 			p->is_black = p->right->is_black;
 			p->right->is_black = true;
-			p->left->is_dbl_black_right = false;
+			p->right->is_dbl_black_right = false;
 		}
 		// case 3-a: black sibling with black children, red parent
 		else if (p->left && p->left->is_black && !p->is_black) {
+			tree_stats.remove_cases[REMOVE_CASE_3A]++;
 			p->is_black = true;
 			p->is_dbl_black_right = false;
 			p->left->is_black = false;
 		}
 		// case 3-b: black sibling with black children, black parent
 		else if (p->left && p->left->is_black && p->is_black) {
+			tree_stats.remove_cases[REMOVE_CASE_3B]++;
 			p->is_dbl_black_right = false;
 			if (left_parent)
 				g->is_dbl_black_left = true;
@@ -515,10 +714,12 @@ RBTCollection <K,V>::remove_color_adjust(Node* subtree_root) {
 }
 
 
-template <typename K, typename V>
-bool RBTCollection<K,V>::find(const K& key, V& val) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool RBTCollection<K,V,NodeAlloc>::find(const K& key, V& val) const {
+	COLLECTION_OP("RBT", OP_FIND);
 	Node* curr = root;
-	while (curr)
+	while (curr) {
+		COLLECTION_PROBES(1);
 		if (key == curr->key) {
 			val = curr->value;
 			return true;
@@ -527,59 +728,155 @@ bool RBTCollection<K,V>::find(const K& key, V& val) const {
 			curr = curr->left;
 		else
 			curr = curr->right;
+	}
 
 	return false;
 }
 
 
-template <typename K, typename V> void
-RBTCollection<K,V>::range_search(const Node* subtree, const K& k1, const K& k2, std::vector <K>& ks) const {
-	if (!subtree)
-		return;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::find_batch(const K* ks, int n, V* vals, std::vector<bool>& found) const {
+	found.assign(n, false);
+	find_nodes_batch(root, ks, n, batch_group_size, [&](int i, const Node* node) {
+		vals[i] = node->value;
+		found[i] = true;
+	});
+}
 
-	if (subtree->key < k1)
-		range_search(subtree->right, k1, k2, ks);
-	else if (subtree->key >= k1 && subtree->key <= k2) {
-		ks.push_back(subtree->key);
-		range_search(subtree->left, k1, k2, ks);
-		range_search(subtree->right, k1, k2, ks);
-	}
-	else
-		range_search(subtree->left, k1, k2, ks);
+
+template <typename K, typename V, template <typename> class NodeAlloc> void
+RBTCollection<K,V,NodeAlloc>::range_search(const Node* subtree, const K& k1, const K& k2, std::vector <K>& ks) const {
+	inorder_nodes(subtree, &k1, &k2, [&ks](const Node* ptr) {
+		ks.push_back(ptr->key);
+		return true;
+	});
 }
 
 
-template <typename K, typename V> void
-RBTCollection<K,V>::find(const K& k1, const K& k2, std::vector <K>& ks) const {
-	// defer to the range search (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc> void
+RBTCollection<K,V,NodeAlloc>::find(const K& k1, const K& k2, std::vector <K>& ks) const {
+	COLLECTION_OP("RBT", OP_RANGE);
+	// defer to the range search (iterative) helper function
 	ks.clear();
 	range_search(root, k1, k2, ks);
+	COLLECTION_PROBES(ks.size());
 }
 
 
-template <typename K, typename V>
-void RBTCollection<K,V>::inorder(const Node* subtree, std::vector <K>& ks) const {
-	if (!subtree)
-		return;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::inorder(const Node* subtree, std::vector <K>& ks) const {
+	inorder_nodes(subtree, (const K*) nullptr, (const K*) nullptr, [&ks](const Node* ptr) {
+		ks.push_back(ptr->key);
+		return true;
+	});
+}
+
 
-	inorder(subtree->left, ks);
-	ks.push_back(subtree->key);
-	inorder(subtree->right, ks);
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::preorder(const Node* subtree, std::vector <K>& ks) const {
+	preorder_nodes(subtree, [&ks](const Node* ptr) { ks.push_back(ptr->key); });
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::rank(const K& key, bool or_equal) const {
+	// add up the left subtrees and nodes passed on the way right
+	int r = 0;
+	const Node* curr = root;
+	while (curr)
+		if (key < curr->key || (!or_equal && key == curr->key))
+			curr = curr->left;
+		else {
+			r += count_of(curr->left) + 1;
+			curr = curr->right;
+		}
+	return r;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::rank(const K& key) const {
+	return rank(key, false);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool RBTCollection<K,V,NodeAlloc>::select(int i, K& key, V& val) const {
+	if (i < 0 || i >= collection_size)
+		return false;
+	const Node* curr = root;
+	while (true) {
+		int left_count = count_of(curr->left);
+		if (i < left_count)
+			curr = curr->left;
+		else if (i == left_count) {
+			key = curr->key;
+			val = curr->value;
+			return true;
+		}
+		else {
+			i -= left_count + 1;
+			curr = curr->right;
+		}
+	}
 }
 
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::count(const K& k1, const K& k2) const {
+	if (k2 < k1)
+		return 0;
+	return rank(k2, true) - rank(k1, false);
+}
 
-template <typename K, typename V>
-void RBTCollection<K,V>::preorder(const Node* subtree, std::vector <K>& ks) const {
-	if (!subtree)
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::collect_from(int i, const K* k2, int limit, std::vector <K>& ks) const {
+	if (i < 0 || i >= collection_size || limit <= 0)
 		return;
+	// descend to position i, keeping the nodes still to come in order (the
+	// ones whose left subtree the path enters, then the node itself)
+	std::vector<const Node*> stack;
+	const Node* curr = root;
+	while (curr) {
+		int left_count = count_of(curr->left);
+		if (i < left_count) {
+			stack.push_back(curr);
+			curr = curr->left;
+		}
+		else if (i == left_count) {
+			stack.push_back(curr);
+			break;
+		}
+		else {
+			i -= left_count + 1;
+			curr = curr->right;
+		}
+	}
+	// then continue the in-order walk from there
+	while (!stack.empty() && static_cast<int>(ks.size()) < limit) {
+		curr = stack.back();
+		stack.pop_back();
+		if (k2 && *k2 < curr->key)
+			return;
+		ks.push_back(curr->key);
+		for (curr = curr->right; curr; curr = curr->left)
+			stack.push_back(curr);
+	}
+}
 
-	ks.push_back(subtree->key);
-	preorder(subtree->left, ks);
-	preorder(subtree->right, ks);
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::find(const K& k1, const K& k2, int offset, int limit, std::vector <K>& ks) const {
+	ks.clear();
+	if (offset < 0 || k2 < k1)
+		return;
+	collect_from(rank(k1) + offset, &k2, limit, ks);
 }
 
-template <typename K, typename V>
-void RBTCollection<K,V>::print(Node* subtree_root) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::sort(int offset, int limit, std::vector <K>& ks) const {
+	ks.clear();
+	collect_from(offset, nullptr, limit, ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::print(Node* subtree_root) const {
 	if (!subtree_root)
 		return;
 	std::cout<<subtree_root->key<<" "<<subtree_root->is_black<<"\n";
@@ -587,57 +884,159 @@ void RBTCollection<K,V>::print(Node* subtree_root) const {
 	print(subtree_root->right);
 }
 
-template <typename K, typename V>
-void RBTCollection<K,V>::print() const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::print() const {
 	print(root);
 }
 
 
-template <typename K, typename V>
-void RBTCollection<K,V>::keys(std::vector <K>& ks) const {
-	// defer to the inorder (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::keys(std::vector <K>& ks) const {
+	// defer to the inorder (iterative) helper function
 	ks.clear();
 	inorder(root, ks);
 }
 
 
-template <typename K, typename V>
-void RBTCollection<K,V>::sort(std::vector <K>& ks) const {
-	// defer to the inorder (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::sort(std::vector <K>& ks) const {
+	// defer to the inorder (iterative) helper function
 	ks.clear();
 	inorder(root, ks);
-	std::sort(ks.begin(), ks.end());
 }
 
 
-template <typename K, typename V>
-int RBTCollection<K,V>::size() const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::parallel_keys(std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		keys(ks);
+		return;
+	}
+	inorder_keys_in_parallel(pool, root, (const K*) nullptr, (const K*) nullptr, ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::parallel_sort(std::vector <K>& ks, ThreadPool& pool) const {
+	// the in-order walk is already sorted
+	parallel_keys(ks, pool);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::parallel_find(const K& k1, const K& k2, std::vector <K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		find(k1, k2, ks);
+		return;
+	}
+	inorder_keys_in_parallel(pool, root, &k1, &k2, ks);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::size() const {
 	return collection_size;
 }
 
 
-template <typename K, typename V>
-int RBTCollection<K,V>::height(const Node* subtree_root) const {
-	int left_height;
-	int right_height;
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::height(const Node* subtree_root) const {
+	return tree_height(subtree_root);
+}
+
 
-	if (!subtree_root)
-		return 0;
+template <typename K, typename V, template <typename> class NodeAlloc>
+TreeStats RBTCollection<K,V,NodeAlloc>::stats() const {
+	TreeStats current = tree_stats;
+	current.nodes = collection_size;
+	return current;
+}
 
-	left_height = height(subtree_root->left);
-	right_height = height(subtree_root->right);
 
-	if (left_height > right_height)
-		return left_height + 1;
-	else
-		return right_height + 1;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::reset_stats() {
+	reset_counters(tree_stats);
 }
 
 
-template <typename K, typename V>
-int RBTCollection<K,V>::height() const {
-	// defer to the height (recursive) helper function
+template <typename K, typename V, template <typename> class NodeAlloc>
+int RBTCollection<K,V,NodeAlloc>::height() const {
+	// defer to the height (iterative) helper function
 	return height(root);
 }
 
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool RBTCollection<K,V,NodeAlloc>::inorder(const Node* subtree, const std::function<bool(const K&, const V&)>& visitor) const {
+	return inorder_nodes(subtree, (const K*) nullptr, (const K*) nullptr, [&visitor](const Node* ptr) {
+		return visitor(ptr->key, ptr->value);
+	});
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool RBTCollection<K,V,NodeAlloc>::range_search(const Node* subtree, const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	return inorder_nodes(subtree, &k1, &k2, [&visitor](const Node* ptr) {
+		return visitor(ptr->key, ptr->value);
+	});
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	// defer to the inorder (iterative) helper function
+	inorder(root, visitor);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void RBTCollection<K,V,NodeAlloc>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	// defer to the range search (iterative) helper function
+	range_search(root, k1, k2, visitor);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Iter>
+void RBTCollection<K,V,NodeAlloc>::bulk_load(Iter begin, Iter end) {
+	if (!keys_ascending(begin, end)) {
+		std::vector<std::pair<K,V>> sorted;
+		sort_by_key(begin, end, sorted);
+		bulk_load(sorted.begin(), sorted.end());
+		return;
+	}
+	make_empty();
+	int n = std::distance(begin, end);
+	// every leaf of a balanced tree is on the last level or the one above,
+	// so coloring the last level red (unless it is full) keeps the black
+	// height equal on every path
+	int last_level = 0;
+	while ((2 << last_level) <= n)
+		last_level++;
+	int red_depth = (n & (n + 1)) == 0 ? -1 : last_level;
+	root = build(begin, n, 0, red_depth);
+	collection_size = n;
+	tree_stats.max_depth = std::max(tree_stats.max_depth, balanced_height(n));
+	tree_stats.black_height = balanced_height(n) - (red_depth >= 0);
+}
+
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Iter>
+typename RBTCollection<K,V,NodeAlloc>::Node* RBTCollection<K,V,NodeAlloc>::build(Iter& it, int n, int depth, int red_depth) {
+	if (n == 0)
+		return nullptr;
+	// build the left half first so the pairs are used in order
+	Node* left = build(it, (n - 1) / 2, depth + 1, red_depth);
+	Node* ptr = nodes.create();
+	ptr->key = it->first;
+	ptr->value = it->second;
+	++it;
+	ptr->left = left;
+	ptr->right = build(it, n - 1 - (n - 1) / 2, depth + 1, red_depth);
+	ptr->count = n;
+	ptr->is_black = depth != red_depth;
+	ptr->is_dbl_black_left = false;
+	ptr->is_dbl_black_right = false;
+	return ptr;
+}
+
 #endif
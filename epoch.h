@@ -0,0 +1,223 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Epoch based reclamation for the lock-free collections. A
+thread reads shared nodes only while it holds an EpochGuard, and a node
+taken out of a structure is handed to epoch_retire() instead of being
+deleted. The retired node is freed once every thread that was inside a
+guard when it was retired has left its guard, so no reader can still hold
+a pointer to it.
+
+There is one global epoch. Each thread publishes the epoch it entered its
+guard in; the global epoch moves on once every thread inside a guard has
+entered in the current one, and a node retired in epoch e is freed once
+the global epoch reaches e + 2. Each thread keeps its own queue of retired
+nodes, which is in epoch order since the global epoch only grows, and
+every few dozen retires frees from its front what has become safe. A
+collection therefore costs nothing for the nodes that must still wait (a
+long lived guard can hold up a great many). What a thread still has retired
+when it exits is handed to whichever thread collects after the epoch next
+moves on.
+*/
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+
+
+// enter a read side critical section for the life of the guard (guards
+// nest)
+class EpochGuard {
+public:
+	EpochGuard();
+	~EpochGuard();
+
+	EpochGuard(const EpochGuard& rhs) = delete;
+	EpochGuard& operator =(const EpochGuard& rhs) = delete;
+};
+
+
+// free ptr with deleter once no thread inside a guard can still see it
+void epoch_retire(void* ptr, void (*deleter)(void*));
+
+// free ptr with delete once no thread inside a guard can still see it
+template <typename T>
+void epoch_retire(T* ptr) {
+	epoch_retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+}
+
+// try to move the epoch on and free what this thread retired that is now
+// safe to free (retiring does this every so often)
+void epoch_collect();
+
+
+// a retired pointer and the global epoch it was retired in
+struct RetiredPointer {
+	void* ptr;
+	void (*deleter)(void*);
+	unsigned long epoch;
+};
+
+// the published state of a thread (records are reused, never freed)
+struct EpochRecord {
+	// (epoch << 1) | 1 while the thread is inside a guard, 0 otherwise
+	std::atomic<unsigned long> state;
+	// true while a thread owns the record
+	std::atomic<bool> in_use;
+	// guards the owner has entered (only used by the owner)
+	int depth;
+	EpochRecord* next;
+};
+
+// the global epoch and every thread's record
+struct EpochDomain {
+	std::atomic<unsigned long> epoch{0};
+	std::atomic<EpochRecord*> records{nullptr};
+
+	// retired pointers left by exited threads, and the global epoch they
+	// were last checked in (nothing more is safe to free until it moves)
+	std::mutex orphans_lock;
+	std::vector<RetiredPointer> orphans;
+	unsigned long orphans_checked = 0;
+
+	// the domain lives as long as the program (threads may exit after
+	// static destruction has begun)
+	static EpochDomain& instance() {
+		static EpochDomain* domain = new EpochDomain;
+		return *domain;
+	}
+};
+
+// this thread's record and retired pointers
+struct EpochThread {
+	EpochRecord* record = nullptr;
+	// oldest first
+	std::deque<RetiredPointer> retired;
+	// retires since the last collection
+	int since_collect = 0;
+
+	// give the record back and leave the retired pointers to the others
+	~EpochThread();
+};
+
+// retires between collections on a thread
+const int epoch_collect_interval = 64;
+
+
+inline thread_local EpochThread epoch_thread;
+
+// return this thread's record, claiming one on first use
+inline EpochRecord* epoch_record() {
+	if (epoch_thread.record)
+		return epoch_thread.record;
+	EpochDomain& domain = EpochDomain::instance();
+	for (EpochRecord* r = domain.records.load(std::memory_order_acquire); r; r = r->next) {
+		bool free = false;
+		if (r->in_use.compare_exchange_strong(free, true)) {
+			epoch_thread.record = r;
+			return r;
+		}
+	}
+	EpochRecord* r = new EpochRecord;
+	r->state.store(0);
+	r->in_use.store(true);
+	r->depth = 0;
+	r->next = domain.records.load(std::memory_order_relaxed);
+	while (!domain.records.compare_exchange_weak(r->next, r, std::memory_order_release))
+		;
+	epoch_thread.record = r;
+	return r;
+}
+
+inline EpochGuard::EpochGuard() {
+	EpochRecord* r = epoch_record();
+	if (r->depth++ > 0)
+		return;
+	// publish the epoch, then check it did not move on in between (else a
+	// node retired two epochs back could be freed under this thread)
+	EpochDomain& domain = EpochDomain::instance();
+	unsigned long e = domain.epoch.load(std::memory_order_acquire);
+	for (;;) {
+		r->state.store((e << 1) | 1, std::memory_order_seq_cst);
+		unsigned long now = domain.epoch.load(std::memory_order_seq_cst);
+		if (now == e)
+			break;
+		e = now;
+	}
+}
+
+inline EpochGuard::~EpochGuard() {
+	EpochRecord* r = epoch_thread.record;
+	if (--r->depth == 0)
+		r->state.store(0, std::memory_order_release);
+}
+
+// move the global epoch on if every thread inside a guard is in it, and
+// return the global epoch
+inline unsigned long epoch_try_advance() {
+	EpochDomain& domain = EpochDomain::instance();
+	unsigned long e = domain.epoch.load(std::memory_order_seq_cst);
+	for (EpochRecord* r = domain.records.load(std::memory_order_acquire); r; r = r->next) {
+		unsigned long state = r->state.load(std::memory_order_seq_cst);
+		if ((state & 1) && (state >> 1) != e)
+			return e;
+	}
+	if (domain.epoch.compare_exchange_strong(e, e + 1))
+		return e + 1;
+	return e;
+}
+
+// free the pointers in list retired at least two epochs before epoch (in
+// any order)
+inline void epoch_free(std::vector<RetiredPointer>& list, unsigned long epoch) {
+	size_t kept = 0;
+	for (size_t i = 0; i < list.size(); i++)
+		if (list[i].epoch + 2 <= epoch)
+			list[i].deleter(list[i].ptr);
+		else
+			list[kept++] = list[i];
+	list.resize(kept);
+}
+
+inline void epoch_collect() {
+	unsigned long epoch = epoch_try_advance();
+	std::deque<RetiredPointer>& retired = epoch_thread.retired;
+	while (!retired.empty() && retired.front().epoch + 2 <= epoch) {
+		retired.front().deleter(retired.front().ptr);
+		retired.pop_front();
+	}
+	epoch_thread.since_collect = 0;
+	EpochDomain& domain = EpochDomain::instance();
+	std::unique_lock<std::mutex> guard(domain.orphans_lock, std::try_to_lock);
+	if (guard.owns_lock() && !domain.orphans.empty() && domain.orphans_checked != epoch) {
+		epoch_free(domain.orphans, epoch);
+		domain.orphans_checked = epoch;
+	}
+}
+
+inline void epoch_retire(void* ptr, void (*deleter)(void*)) {
+	EpochDomain& domain = EpochDomain::instance();
+	epoch_thread.retired.push_back(RetiredPointer{ptr, deleter, domain.epoch.load(std::memory_order_seq_cst)});
+	if (++epoch_thread.since_collect == epoch_collect_interval)
+		epoch_collect();
+}
+
+inline EpochThread::~EpochThread() {
+	if (!retired.empty()) {
+		EpochDomain& domain = EpochDomain::instance();
+		std::lock_guard<std::mutex> guard(domain.orphans_lock);
+		domain.orphans.insert(domain.orphans.end(), retired.begin(), retired.end());
+		domain.orphans_checked = 0;
+	}
+	if (record) {
+		record->depth = 0;
+		record->state.store(0);
+		record->in_use.store(false);
+	}
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Read-only search index over n ascending keys, laid out in
+Eytzinger (breadth first) order: the root of the implicit search tree is at
+1 and the children of node k are at 2k and 2k+1. A search walks down from
+the root, and each level's keys sit next to each other, so the top levels
+stay in cache, and a cache line of descendants a few levels down can be
+prefetched while the current level is compared. Each node also keeps the
+sorted position of its key so the caller can find the rest of the pair.
+*/
+
+#ifndef EYTZINGER_H
+#define EYTZINGER_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+
+template <typename K>
+class EytzingerIndex {
+public:
+
+	// create an empty index
+	EytzingerIndex();
+
+	// copy an index (laid out again in this index's own buffer, so node 0
+	// still starts a cache line)
+	EytzingerIndex(const EytzingerIndex<K>& rhs);
+
+	// assign an index (laid out again as for the copy)
+	EytzingerIndex<K>& operator =(const EytzingerIndex<K>& rhs);
+
+	// lay out the n ascending keys key_at(0), ..., key_at(n-1)
+	template <typename KeyAt>
+	void build(int n, KeyAt key_at);
+
+	// drop the index
+	void clear();
+
+	// true if the index has been built (and not cleared since)
+	bool built() const;
+
+	// return the sorted position of the first key >= key (n if none)
+	int lower_bound(const K& key) const;
+
+private:
+
+	// keys per cache line: node k's descendants 2^levels_ahead levels down
+	// are nodes k*keys_per_line .. k*keys_per_line + keys_per_line - 1,
+	// one line when node 0 is line aligned
+	static const int keys_per_line = sizeof(K) < 64 ? 64 / sizeof(K) : 1;
+
+	// keys in breadth first order (node k is nodes[offset + k], with offset
+	// chosen so node 0 starts a cache line)
+	std::vector<K> nodes;
+	int offset;
+
+	// sorted position of the key at each node
+	std::vector<int> positions;
+
+	// number of keys
+	int count;
+
+	// size nodes for n keys and pick offset so node 0 starts a cache line
+	void allocate(int n);
+
+	// helper to fill subtree k with the keys from position i on (in order)
+	template <typename KeyAt>
+	void fill(int k, int& i, KeyAt& key_at);
+};
+
+
+template <typename K>
+EytzingerIndex<K>::EytzingerIndex(): offset(0), count(-1) {}
+
+template <typename K>
+EytzingerIndex<K>::EytzingerIndex(const EytzingerIndex<K>& rhs): offset(0), count(-1) {
+	*this = rhs;
+}
+
+template <typename K>
+EytzingerIndex<K>& EytzingerIndex<K>::operator =(const EytzingerIndex<K>& rhs) {
+	if (this == &rhs)
+		return *this;
+	if (!rhs.built()) {
+		clear();
+		return *this;
+	}
+	// rhs's offset only lines up its own buffer
+	allocate(rhs.count);
+	std::copy(rhs.nodes.begin() + rhs.offset, rhs.nodes.begin() + rhs.offset + rhs.count + 1, nodes.begin() + offset);
+	positions = rhs.positions;
+	count = rhs.count;
+	return *this;
+}
+
+template <typename K>
+void EytzingerIndex<K>::allocate(int n) {
+	// room to slide node 0 onto a cache line boundary
+	nodes.assign(n + 1 + keys_per_line, K());
+	offset = 0;
+	while (reinterpret_cast<std::uintptr_t>(nodes.data() + offset) % 64 != 0 && offset < keys_per_line)
+		offset++;
+	if (offset == keys_per_line)
+		offset = 0;
+}
+
+template <typename K>
+template <typename KeyAt>
+void EytzingerIndex<K>::build(int n, KeyAt key_at) {
+	count = n;
+	allocate(n);
+	positions.assign(n + 1, n);
+	int i = 0;
+	fill(1, i, key_at);
+}
+
+template <typename K>
+template <typename KeyAt>
+void EytzingerIndex<K>::fill(int k, int& i, KeyAt& key_at) {
+	// the recursion is only as deep as the tree, log2(n) levels
+	if (k > count)
+		return;
+	fill(2 * k, i, key_at);
+	nodes[offset + k] = key_at(i);
+	positions[k] = i++;
+	fill(2 * k + 1, i, key_at);
+}
+
+template <typename K>
+void EytzingerIndex<K>::clear() {
+	if (count < 0)
+		return;
+	std::vector<K>().swap(nodes);
+	std::vector<int>().swap(positions);
+	count = -1;
+}
+
+template <typename K>
+bool EytzingerIndex<K>::built() const {
+	return count >= 0;
+}
+
+template <typename K>
+int EytzingerIndex<K>::lower_bound(const K& key) const {
+	const K* base = nodes.data() + offset;
+	int k = 1;
+	while (k <= count) {
+		__builtin_prefetch(base + static_cast<long>(k) * keys_per_line);
+		// go right past keys < key, without a branch
+		k = 2 * k + (base[k] < key);
+	}
+	// the last node where the walk went left holds the answer: undo the
+	// right turns after it (trailing ones) and that left turn
+	k >>= __builtin_ffs(~k);
+	return k == 0 ? count : positions[k];
+}
+
+#endif
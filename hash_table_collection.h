@@ -8,20 +8,24 @@ Description: Implementation of Collect using a hash table
 #define HASH_TABLE_COLLECTION_H
 
 #include <vector>
+#include <utility>
 #include <algorithm>
 #include <functional>
+#include <type_traits>
 #include "collection.h"
-template <typename K, typename V>
+#include "node_allocator.h"
+#include "instrumentation.h"
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool>
 class HashTableCollection: public Collection<K,V> {
 	public:
 		// create an empty linked list
 		HashTableCollection();
 
 		// copy a linked list
-		HashTableCollection(const HashTableCollection<K,V>& rhs);
+		HashTableCollection(const HashTableCollection<K,V,NodeAlloc>& rhs);
 
 		// assign a linked list
-		 HashTableCollection<K,V>& operator =(const HashTableCollection<K,V>& rhs);
+		 HashTableCollection<K,V,NodeAlloc>& operator =(const HashTableCollection<K,V,NodeAlloc>& rhs);
 
 		// delete a linked list
 		~HashTableCollection();
@@ -29,6 +33,14 @@ class HashTableCollection: public Collection<K,V> {
 		// insert a key -value pair into the collection
 		void insert(const K& key , const V& val);
 
+		// insert a key-value pair, moving the key and value into the collection
+		void insert(K&& key, V&& val);
+
+		// insert a key-value pair with the key forwarded from key and the value
+		// constructed in place from args
+		template <typename KArg, typename... Args>
+		void emplace(KArg&& key, Args&&... args);
+
 		// remove a key -value pair from the collection
 		void remove(const K& key);
 
@@ -38,29 +50,69 @@ class HashTableCollection: public Collection<K,V> {
 		// find the keys associated with the range
 		void find(const K& k1, const K& k2, std::vector<K>& keys) const;
 
+		// find the values of keys[0..n-1], prefetching the buckets and then
+		// the chain heads of a group of keys before walking any chain
+		void find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const;
+
 		// return all keys in the collection
 		void keys(std::vector<K>& keys) const;
 
 		// return collection keys in sorted order
 		void sort(std::vector<K>& keys) const;
 
+		// keys(), sort() and find(k1, k2, keys) with the buckets scanned on pool
+		void parallel_keys(std::vector<K>& keys, ThreadPool& pool) const;
+		void parallel_sort(std::vector<K>& keys, ThreadPool& pool) const;
+		void parallel_find(const K& k1, const K& k2, std::vector<K>& keys, ThreadPool& pool) const;
+
 		// return the number of keys in collection
 		int size() const;
 
+		// call visitor on each key-value pair until it returns false
+		void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// call visitor on each key-value pair with k1 <= key <= k2
+		// until it returns false
+		void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
 	private:
 		// helper to empty entire hash table
 		void make_empty();
 
-		// resize and rehash the hash table
+		// start growing the hash table (the nodes are moved over a few
+		// buckets at a time by rehash_step())
 		void resize_and_rehash();
 
+		// move the next few buckets of the old table into the new one
+		void rehash_step();
+
 		// linked list node structure
 		struct Node {
+			// construct the key from k and the value from args
+			template <typename KArg, typename... Args>
+			Node(std::piecewise_construct_t, KArg&& k, Args&&... args): key(std::forward<KArg>(k)),
+				value(std::forward<Args>(args)...) {}
+			Node() {}
+
 			K key;
 			V value;
 			Node* next;
 		};
 
+		// set heads to the chains that may hold key (the new table's and,
+		// if its bucket has not been moved yet, the old table's) and
+		// return how many were set
+		int chains(const K& key, Node** heads[2]) const;
+
+		// call visitor on each key-value pair whose key passes pred
+		template <typename Pred>
+		void visit_if(Pred pred, const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// set keys to the keys that pass pred, in the order keys() gives,
+		// scanning runs of buckets on pool
+		template <typename Pred>
+		void scan_in_parallel(Pred pred, std::vector<K>& keys, ThreadPool& pool) const;
+
 	// number of k-v pairs in the collection
 	int collection_size;
 
@@ -72,11 +124,27 @@ class HashTableCollection: public Collection<K,V> {
 
 	// hash table array
 	Node** hash_table;
+
+	// table being rehashed into hash_table (nullptr when not rehashing)
+	Node** old_table;
+
+	// number of buckets in the old table
+	int old_capacity;
+
+	// next bucket of the old table to move (all before it are moved)
+	int rehash_index;
+
+	// number of non-empty buckets moved per insert or remove
+	static const int rehash_step_buckets = 4;
+
+	// allocator for the chain nodes
+	NodeAlloc<Node> nodes;
 };
 
 
-template <typename K, typename V>
-HashTableCollection<K,V>::HashTableCollection(): collection_size(0), table_capacity(16), load_factor_threshold(0.75) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+HashTableCollection<K,V,NodeAlloc>::HashTableCollection(): collection_size(0), table_capacity(16), load_factor_threshold(0.75),
+	old_table(nullptr), old_capacity(0), rehash_index(0) {
 	// dynamically allocate the hash table array
 	hash_table = new Node*[table_capacity];
 	// initialize the hash table chains
@@ -84,39 +152,57 @@ HashTableCollection<K,V>::HashTableCollection(): collection_size(0), table_capac
 		hash_table[i] = nullptr;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::make_empty() {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::make_empty() {
 	// make sure hash table exists
 	if(!hash_table) 
 		return;
-	// remove each key
-	for (int i = 0; i < table_capacity; i++) {
-		Node* curr_node = hash_table[i];
-		Node* previous = curr_node;
-		while (curr_node) {
-			previous = curr_node;
-			curr_node = curr_node->next;
-			delete previous;
+	// remove each key (a pool frees all the nodes at once, so they only
+	// need to be visited if they have destructors to run)
+	if (!NodeAlloc<Node>::bulk_release || !std::is_trivially_destructible<Node>::value) {
+		for (int i = 0; i < table_capacity; i++) {
+			Node* curr_node = hash_table[i];
+			Node* previous = curr_node;
+			while (curr_node) {
+				previous = curr_node;
+				curr_node = curr_node->next;
+				nodes.destroy(previous);
+			}
+		}
+		// and each key not yet moved out of the old table
+		if (old_table) {
+			for (int i = rehash_index; i < old_capacity; i++) {
+				Node* curr_node = old_table[i];
+				while (curr_node) {
+					Node* previous = curr_node;
+					curr_node = curr_node->next;
+					nodes.destroy(previous);
+				}
+			}
 		}
 	}
-	delete hash_table;
+	nodes.release();
+	delete[] old_table;
+	old_table = nullptr;
+	delete[] hash_table;
 	hash_table = nullptr;
 	collection_size = 0;
 }
 
-template <typename K, typename V>
-HashTableCollection<K,V>::~HashTableCollection() {
+template <typename K, typename V, template <typename> class NodeAlloc>
+HashTableCollection<K,V,NodeAlloc>::~HashTableCollection() {
 	make_empty();
 }
 
 
-template <typename K, typename V>
-HashTableCollection<K,V>::HashTableCollection(const HashTableCollection<K,V>& rhs): hash_table(nullptr), load_factor_threshold(rhs.load_factor_threshold) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+HashTableCollection<K,V,NodeAlloc>::HashTableCollection(const HashTableCollection<K,V,NodeAlloc>& rhs): load_factor_threshold(rhs.load_factor_threshold),
+	hash_table(nullptr), old_table(nullptr), old_capacity(0), rehash_index(0) {
 	*this = rhs;
 }
 
-template <typename K, typename V>
-HashTableCollection<K,V>& HashTableCollection<K,V>::operator=(const HashTableCollection<K,V>& rhs) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+HashTableCollection<K,V,NodeAlloc>& HashTableCollection<K,V,NodeAlloc>::operator=(const HashTableCollection<K,V,NodeAlloc>& rhs) {
 	// check if rhs is current object and return current object
 	if(this == &rhs)
 		return *this;
@@ -129,9 +215,8 @@ HashTableCollection<K,V>& HashTableCollection<K,V>::operator=(const HashTableCol
 	hash_table = new Node*[table_capacity];
 	for(int i = 0; i < table_capacity; ++i)
 		hash_table[i] = nullptr;
-	// do the copy
-	Node* curr_node = new Node;
-	Node* lhs_node;
+	// do the copy (including any keys rhs has not moved yet)
+	Node* curr_node;
 	for(int i = 0; i < table_capacity; i++) {
 		curr_node = rhs.hash_table[i];
 		while(curr_node) {
@@ -139,129 +224,215 @@ HashTableCollection<K,V>& HashTableCollection<K,V>::operator=(const HashTableCol
 			curr_node = curr_node->next;
 		}
 	}
+	if (rhs.old_table) {
+		for(int i = rhs.rehash_index; i < rhs.old_capacity; i++) {
+			curr_node = rhs.old_table[i];
+			while(curr_node) {
+				insert(curr_node->key, curr_node->value);
+				curr_node = curr_node->next;
+			}
+		}
+	}
 	return *this;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::resize_and_rehash() {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::resize_and_rehash() {
+	COLLECTION_REHASH("HashTable");
+	// finish off any rehash still in progress
+	while (old_table)
+		rehash_step();
 	// setup new table
 	int new_capacity = table_capacity * 2;
-	int new_collection_size = 0;
 	// dynamically allocate the new table
 	Node** new_table = new Node*[new_capacity];
 	// initialize new table
 	for(int i = 0; i < new_capacity; ++i)
 		new_table[i] = nullptr;
-	// insert key values
-	std::vector<K> ks;
-	keys(ks);
-
-	for(K key: ks) {
-		// hash the key
-		std::hash<K> hash_fun;
-		size_t value = hash_fun(key);
-		size_t index = value % new_capacity;
-		// create a new node in new table
-		Node* ptr = new Node;
-		V val;
-		find(key, val);
-		ptr->key = key;
-		ptr->value = val;
-		ptr->next = new_table[index];
-		new_table[index] = ptr;
-		new_collection_size++;
-	}
-	// clear the current data
-	make_empty();
+	// keep the current table live until its buckets have been moved
+	old_table = hash_table;
+	old_capacity = table_capacity;
+	rehash_index = 0;
 	// update to the new settings
 	hash_table = new_table;
 	table_capacity = new_capacity;
-	collection_size = new_collection_size;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::insert(const K& key , const V& val) {
-	// check current load factor versus load factor threshold ,
-	// and resize and copy if necessary by calling resize_and_rehash()
-	double load_factor = static_cast<double>(collection_size) / table_capacity;
-	if (load_factor > 0.75)
-		resize_and_rehash();
-	// hash the key
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::rehash_step() {
+	// bound the empty buckets skipped as well as the chains moved
+	int moved = 0;
+	int visited = 0;
+	std::hash<K> hash_fun;
+	while (rehash_index < old_capacity && moved < rehash_step_buckets && visited < 10 * rehash_step_buckets) {
+		Node* curr_node = old_table[rehash_index];
+		if (curr_node)
+			moved++;
+		// relink each node onto the front of its new chain
+		while (curr_node) {
+			Node* next_node = curr_node->next;
+			size_t index = hash_fun(curr_node->key) % table_capacity;
+			curr_node->next = hash_table[index];
+			hash_table[index] = curr_node;
+			curr_node = next_node;
+		}
+		old_table[rehash_index] = nullptr;
+		rehash_index++;
+		visited++;
+	}
+	if (rehash_index == old_capacity) {
+		delete[] old_table;
+		old_table = nullptr;
+	}
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int HashTableCollection<K,V,NodeAlloc>::chains(const K& key, Node** heads[2]) const {
 	std::hash<K> hash_fun;
 	size_t value = hash_fun(key);
-	size_t index = value % table_capacity;
-	// create the new node
-	Node* ptr = new Node;
-	ptr->key = key;
-	ptr->value = val;
-	ptr->next = nullptr;
+	int count = 0;
+	heads[count++] = &hash_table[value % table_capacity];
+	if (old_table) {
+		size_t old_index = value % old_capacity;
+		if (old_index >= static_cast<size_t>(rehash_index))
+			heads[count++] = &old_table[old_index];
+	}
+	return count;
+}
 
-	Node* curr_node;
-	if (!hash_table[index])
-		hash_table[index] = ptr;
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::insert(const K& key, const V& val) {
+	emplace(key, val);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::insert(K&& key, V&& val) {
+	emplace(std::move(key), std::move(val));
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename KArg, typename... Args>
+void HashTableCollection<K,V,NodeAlloc>::emplace(KArg&& key, Args&&... args) {
+	COLLECTION_OP("HashTable", OP_INSERT);
+	// move part of an in-progress rehash, otherwise check current load
+	// factor versus load factor threshold and start a resize if necessary
+	if (old_table)
+		rehash_step();
 	else {
-		curr_node = hash_table[index];
-		hash_table[index] = ptr;
-		ptr->next = curr_node;
+		double load_factor = static_cast<double>(collection_size) / table_capacity;
+		if (load_factor > load_factor_threshold)
+			resize_and_rehash();
 	}
+	// create the new node
+	Node* ptr = nodes.create(std::piecewise_construct, std::forward<KArg>(key), std::forward<Args>(args)...);
+	// new keys always go in the new table
+	std::hash<K> hash_fun;
+	size_t value = hash_fun(ptr->key);
+	size_t index = value % table_capacity;
+	ptr->next = hash_table[index];
+	hash_table[index] = ptr;
 	// update the size
 	collection_size++;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::remove(const K& key) {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::remove(const K& key) {
+	COLLECTION_OP("HashTable", OP_REMOVE);
 	if (collection_size == 0)
 		return;
-
-	std::hash<K> hash_fun;
-	size_t value = hash_fun(key);
-	size_t index = value % table_capacity;
-
-	Node* curr_node = hash_table[index];
-	Node* curr_node_previous = curr_node;
-	while (curr_node) {
-		if (curr_node->key == key) {
-			if (curr_node == hash_table[index]) {
-				if (!curr_node->next)
-					hash_table[index] = nullptr;
+	if (old_table)
+		rehash_step();
+
+	Node** heads[2];
+	int count = chains(key, heads);
+	for (int c = 0; c < count; c++) {
+		Node* curr_node = *heads[c];
+		Node* curr_node_previous = curr_node;
+		while (curr_node) {
+			COLLECTION_PROBES(1);
+			if (curr_node->key == key) {
+				if (curr_node == *heads[c])
+					*heads[c] = curr_node->next;
 				else
-					hash_table[index] = curr_node->next;
+					curr_node_previous->next = curr_node->next;
+				nodes.destroy(curr_node);
+				collection_size--;
+				return;
 			}
-			else 
-				curr_node_previous->next = curr_node->next;
-			delete curr_node;
-			collection_size--;
-			return;
+			curr_node_previous = curr_node;
+			curr_node = curr_node->next;
 		}
-		curr_node_previous = curr_node;
-		curr_node = curr_node->next;
 	}
 	return;
 
 }
 
-template <typename K, typename V>
-bool HashTableCollection<K,V>::find(const K& key , V& val) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+bool HashTableCollection<K,V,NodeAlloc>::find(const K& key , V& val) const {
+	COLLECTION_OP("HashTable", OP_FIND);
 	if (collection_size == 0)
 		return false;
 
-	std::hash<K> hash_fun;
-	size_t value = hash_fun(key);
-	size_t index = value % table_capacity;
-
-	Node* curr_node = hash_table[index];
-	while (curr_node) {
-		if (curr_node->key == key) {
-			val = curr_node->value;
-			return true;
+	Node** heads[2];
+	int count = chains(key, heads);
+	int links = 0;
+	for (int c = 0; c < count; c++) {
+		Node* curr_node = *heads[c];
+		while (curr_node) {
+			links++;
+			if (curr_node->key == key) {
+				val = curr_node->value;
+				COLLECTION_PROBES(links);
+				COLLECTION_CHAIN("HashTable", links);
+				return true;
+			}
+			curr_node = curr_node->next;
 		}
-		curr_node = curr_node->next;
 	}
+	COLLECTION_PROBES(links);
+	COLLECTION_CHAIN("HashTable", links);
 	return false;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const {
+	found.assign(n, false);
+	if (collection_size == 0)
+		return;
+
+	Node** heads[batch_group_size][2];
+	int counts[batch_group_size];
+	for (int base = 0; base < n; base += batch_group_size) {
+		int group = std::min(batch_group_size, n - base);
+		// stage 1: hash the keys and prefetch their buckets
+		for (int j = 0; j < group; j++) {
+			counts[j] = chains(keys[base + j], heads[j]);
+			for (int c = 0; c < counts[j]; c++)
+				__builtin_prefetch(heads[j][c]);
+		}
+		// stage 2: prefetch the first node of each chain
+		for (int j = 0; j < group; j++)
+			for (int c = 0; c < counts[j]; c++)
+				if (*heads[j][c])
+					__builtin_prefetch(*heads[j][c]);
+		// stage 3: walk the chains
+		for (int j = 0; j < group; j++) {
+			const K& key = keys[base + j];
+			for (int c = 0; c < counts[j] && !found[base + j]; c++)
+				for (Node* curr_node = *heads[j][c]; curr_node; curr_node = curr_node->next)
+					if (curr_node->key == key) {
+						vals[base + j] = curr_node->value;
+						found[base + j] = true;
+						break;
+					}
+		}
+	}
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+	COLLECTION_OP("HashTable", OP_RANGE);
+	COLLECTION_PROBES(collection_size);
 	if (collection_size == 0)
 		return;
 	keys.clear();
@@ -274,8 +445,8 @@ void HashTableCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& ke
 	return;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::keys(std::vector<K>& keys) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::keys(std::vector<K>& keys) const {
 	keys.clear();
 	if (collection_size == 0)
 		return;
@@ -290,20 +461,99 @@ void HashTableCollection<K,V>::keys(std::vector<K>& keys) const {
 			}
 		}
 	}
+	// keys not yet moved out of the old table
+	if (old_table) {
+		for(int i = rehash_index; i < old_capacity; i++) {
+			curr_node = old_table[i];
+			while(curr_node) {
+				keys.push_back(curr_node->key);
+				curr_node = curr_node->next;
+			}
+		}
+	}
 	return;
 }
 
-template <typename K, typename V>
-void HashTableCollection<K,V>::sort(std::vector<K>& ks) const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::sort(std::vector<K>& ks) const {
 	if (collection_size == 0)
 		return;
 	keys(ks);
 	std::sort(ks.begin(), ks.end());
 }
 
-template <typename K, typename V>
-int HashTableCollection<K,V>::size() const {
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Pred>
+void HashTableCollection<K,V,NodeAlloc>::scan_in_parallel(Pred pred, std::vector<K>& ks, ThreadPool& pool) const {
+	// number the buckets of the table, then the ones not yet moved out of
+	// the old table, and give each piece an equal run of them
+	int buckets = table_capacity + (old_table ? old_capacity - rehash_index : 0);
+	int pieces = std::min(buckets, parallel_pieces(pool));
+	std::vector<std::vector<K>> parts(pieces);
+	parallel_for(pool, pieces, [&](int p) {
+		int end = static_cast<long long>(buckets) * (p + 1) / pieces;
+		for (int i = static_cast<long long>(buckets) * p / pieces; i < end; i++) {
+			Node* curr_node = i < table_capacity ? hash_table[i] : old_table[rehash_index + i - table_capacity];
+			for (; curr_node; curr_node = curr_node->next)
+				if (pred(curr_node->key))
+					parts[p].push_back(curr_node->key);
+		}
+	});
+	concat_in_parallel(pool, parts, ks);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::parallel_keys(std::vector<K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		keys(ks);
+		return;
+	}
+	scan_in_parallel([](const K&) { return true; }, ks, pool);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::parallel_sort(std::vector<K>& ks, ThreadPool& pool) const {
+	parallel_keys(ks, pool);
+	sort_in_parallel(pool, ks);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::parallel_find(const K& k1, const K& k2, std::vector<K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		find(k1, k2, ks);
+		return;
+	}
+	scan_in_parallel([&k1, &k2](const K& key) { return key >= k1 && key <= k2; }, ks, pool);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+int HashTableCollection<K,V,NodeAlloc>::size() const {
 	return collection_size;
 }
 
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	visit_if([](const K&) { return true; }, visitor);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+void HashTableCollection<K,V,NodeAlloc>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	visit_if([&k1, &k2](const K& key) { return key >= k1 && key <= k2; }, visitor);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc>
+template <typename Pred>
+void HashTableCollection<K,V,NodeAlloc>::visit_if(Pred pred, const std::function<bool(const K&, const V&)>& visitor) const {
+	for (int i = 0; i < table_capacity; i++)
+		for (Node* curr_node = hash_table[i]; curr_node; curr_node = curr_node->next)
+			if (pred(curr_node->key) && !visitor(curr_node->key, curr_node->value))
+				return;
+	// keys not yet moved out of the old table
+	if (old_table)
+		for (int i = rehash_index; i < old_capacity; i++)
+			for (Node* curr_node = old_table[i]; curr_node; curr_node = curr_node->next)
+				if (pred(curr_node->key) && !visitor(curr_node->key, curr_node->value))
+					return;
+}
+
 #endif
@@ -0,0 +1,304 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Optional instrumentation of the collections' hot paths. When
+built with -DCOLLECTION_METRICS every collection records, per operation
+(insert, find, remove and range find): how many ran, how many probes they
+made (keys compared, or nodes, slots or chain links visited, whichever the
+implementation searches by) and a latency histogram. The hash tables also
+record the chain or probe length of each lookup and count rehashes.
+Without the flag the COLLECTION_* macros expand to nothing, so the
+collections compile exactly as before.
+
+The metrics of all instances of a collection add up under its name. They
+can be dumped to a file as a readable summary or as Prometheus text.
+*/
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <map>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+
+// instrumented operations
+enum CollectionOp {
+	OP_INSERT,
+	OP_FIND,
+	OP_REMOVE,
+	OP_RANGE,
+	OP_COUNT
+};
+
+const char* const collection_op_names[OP_COUNT] = {"insert", "find", "remove", "range"};
+
+
+// histogram of non-negative values in power of two buckets (bucket b holds
+// the values below 2^b not counted in a lower bucket)
+class Histogram {
+public:
+	static const int buckets = 48;
+
+	// count a value
+	void add(long value);
+
+	// number of values, their sum and the count in bucket b
+	long count() const;
+	long sum() const;
+	long bucket(int b) const;
+
+	// the upper bound of the bucket holding the qth fraction of the values
+	// (0 if there are none)
+	long quantile(double q) const;
+
+private:
+	std::atomic<long> counts[buckets] = {};
+	std::atomic<long> total_count{0};
+	std::atomic<long> total_sum{0};
+};
+
+
+// the metrics of one collection implementation
+struct CollectionMetrics {
+	std::atomic<long> ops[OP_COUNT] = {};
+	std::atomic<long> probes[OP_COUNT] = {};
+	Histogram latency_ns[OP_COUNT];
+	Histogram chain_length;
+	std::atomic<long> rehashes{0};
+};
+
+
+// keys a binary search over n keys compares (the bit length of n)
+inline int binary_search_probes(int n) {
+	return n <= 0 ? 0 : 32 - __builtin_clz(n);
+}
+
+
+// return the metrics recorded under name (created on first use)
+CollectionMetrics& collection_metrics(const char* name);
+
+// write the metrics of every collection to the file at path, as a summary
+// table or as Prometheus text, and return true on success
+bool dump_collection_metrics(const char* path, bool prometheus);
+
+
+// times one operation and records it, with the probes counted while it
+// runs, when it goes out of scope
+class OpTimer {
+public:
+	OpTimer(CollectionMetrics& metrics, CollectionOp op);
+	~OpTimer();
+
+	// probes counted on this thread by the innermost running OpTimer
+	static thread_local long probes;
+
+private:
+	CollectionMetrics& metrics;
+	CollectionOp op;
+	long outer_probes;
+	std::chrono::steady_clock::time_point start;
+};
+
+
+#ifdef COLLECTION_METRICS
+
+// time the rest of the enclosing function as operation op of collection
+// name (at most once per function)
+#define COLLECTION_OP(name, op) \
+	static CollectionMetrics& collection_metrics_ = collection_metrics(name); \
+	OpTimer collection_timer_(collection_metrics_, op)
+
+// count n probes toward the running operation (in any function it calls)
+#define COLLECTION_PROBES(n) (OpTimer::probes += (n))
+
+// record the length of a chain or probe sequence of collection name
+#define COLLECTION_CHAIN(name, length) \
+	do { \
+		static CollectionMetrics& collection_metrics_ = collection_metrics(name); \
+		collection_metrics_.chain_length.add(length); \
+	} while (0)
+
+// count a rehash of collection name
+#define COLLECTION_REHASH(name) \
+	do { \
+		static CollectionMetrics& collection_metrics_ = collection_metrics(name); \
+		collection_metrics_.rehashes++; \
+	} while (0)
+
+#else
+
+#define COLLECTION_OP(name, op)
+#define COLLECTION_PROBES(n) ((void) 0)
+#define COLLECTION_CHAIN(name, length) ((void) 0)
+#define COLLECTION_REHASH(name) ((void) 0)
+
+#endif
+
+
+inline void Histogram::add(long value) {
+	// the bit length of value, so 2^(b-1) <= value < 2^b
+	int b = value <= 0 ? 0 : 64 - __builtin_clzl(value);
+	if (b >= buckets)
+		b = buckets - 1;
+	counts[b].fetch_add(1, std::memory_order_relaxed);
+	total_count.fetch_add(1, std::memory_order_relaxed);
+	total_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+inline long Histogram::count() const {
+	return total_count.load(std::memory_order_relaxed);
+}
+
+inline long Histogram::sum() const {
+	return total_sum.load(std::memory_order_relaxed);
+}
+
+inline long Histogram::bucket(int b) const {
+	return counts[b].load(std::memory_order_relaxed);
+}
+
+inline long Histogram::quantile(double q) const {
+	long n = count();
+	if (n == 0)
+		return 0;
+	long seen = 0;
+	for (int b = 0; b < buckets; b++) {
+		seen += bucket(b);
+		if (seen >= q * n)
+			return 1L << b;
+	}
+	return 1L << (buckets - 1);
+}
+
+
+// the registry of metrics by collection name
+struct MetricsRegistry {
+	std::mutex lock;
+	std::map<std::string, CollectionMetrics*> by_name;
+
+	// the metrics live as long as the program (so a dump at exit is safe)
+	static MetricsRegistry& instance() {
+		static MetricsRegistry* registry = new MetricsRegistry;
+		return *registry;
+	}
+};
+
+inline CollectionMetrics& collection_metrics(const char* name) {
+	MetricsRegistry& registry = MetricsRegistry::instance();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	CollectionMetrics*& metrics = registry.by_name[name];
+	if (!metrics)
+		metrics = new CollectionMetrics;
+	return *metrics;
+}
+
+
+// write histogram h as Prometheus metric with labels
+inline void write_prometheus_histogram(std::FILE* file, const char* metric, const std::string& labels,
+	const Histogram& h) {
+	long cumulative = 0;
+	for (int b = 0; b < Histogram::buckets; b++) {
+		cumulative += h.bucket(b);
+		if (h.bucket(b) > 0)
+			std::fprintf(file, "%s_bucket{%s,le=\"%ld\"} %ld\n", metric, labels.c_str(), (1L << b) - 1, cumulative);
+	}
+	std::fprintf(file, "%s_bucket{%s,le=\"+Inf\"} %ld\n", metric, labels.c_str(), h.count());
+	std::fprintf(file, "%s_sum{%s} %ld\n", metric, labels.c_str(), h.sum());
+	std::fprintf(file, "%s_count{%s} %ld\n", metric, labels.c_str(), h.count());
+}
+
+// write the metrics in the Prometheus text format (each metric's series
+// together, as the format requires)
+inline void write_prometheus(std::FILE* file, const std::map<std::string, CollectionMetrics*>& by_name) {
+	typedef std::pair<const std::string, CollectionMetrics*> Entry;
+	std::fprintf(file, "# TYPE collection_ops_total counter\n");
+	for (const Entry& e : by_name)
+		for (int op = 0; op < OP_COUNT; op++)
+			if (e.second->ops[op].load() > 0)
+				std::fprintf(file, "collection_ops_total{collection=\"%s\",op=\"%s\"} %ld\n", e.first.c_str(),
+					collection_op_names[op], e.second->ops[op].load());
+	std::fprintf(file, "# TYPE collection_probes_total counter\n");
+	for (const Entry& e : by_name)
+		for (int op = 0; op < OP_COUNT; op++)
+			if (e.second->ops[op].load() > 0)
+				std::fprintf(file, "collection_probes_total{collection=\"%s\",op=\"%s\"} %ld\n", e.first.c_str(),
+					collection_op_names[op], e.second->probes[op].load());
+	std::fprintf(file, "# TYPE collection_op_latency_ns histogram\n");
+	for (const Entry& e : by_name)
+		for (int op = 0; op < OP_COUNT; op++)
+			if (e.second->latency_ns[op].count() > 0)
+				write_prometheus_histogram(file, "collection_op_latency_ns",
+					"collection=\"" + e.first + "\",op=\"" + collection_op_names[op] + "\"", e.second->latency_ns[op]);
+	std::fprintf(file, "# TYPE collection_chain_length histogram\n");
+	for (const Entry& e : by_name)
+		if (e.second->chain_length.count() > 0)
+			write_prometheus_histogram(file, "collection_chain_length", "collection=\"" + e.first + "\"",
+				e.second->chain_length);
+	std::fprintf(file, "# TYPE collection_rehashes_total counter\n");
+	for (const Entry& e : by_name)
+		if (e.second->rehashes.load() > 0)
+			std::fprintf(file, "collection_rehashes_total{collection=\"%s\"} %ld\n", e.first.c_str(),
+				e.second->rehashes.load());
+}
+
+// write the metrics as a table per operation, then the chain lengths and
+// rehashes
+inline void write_summary(std::FILE* file, const std::map<std::string, CollectionMetrics*>& by_name) {
+	typedef std::pair<const std::string, CollectionMetrics*> Entry;
+	std::fprintf(file, "%-24s %-8s %12s %10s %10s %10s %10s\n", "collection", "op", "count", "probes/op",
+		"mean ns", "p50 ns <", "p99 ns <");
+	for (const Entry& e : by_name)
+		for (int op = 0; op < OP_COUNT; op++) {
+			long count = e.second->ops[op].load();
+			const Histogram& h = e.second->latency_ns[op];
+			if (count > 0)
+				std::fprintf(file, "%-24s %-8s %12ld %10.1f %10.1f %10ld %10ld\n", e.first.c_str(),
+					collection_op_names[op], count, static_cast<double>(e.second->probes[op].load()) / count,
+					static_cast<double>(h.sum()) / h.count(), h.quantile(0.5), h.quantile(0.99));
+		}
+	for (const Entry& e : by_name) {
+		const Histogram& h = e.second->chain_length;
+		if (h.count() > 0)
+			std::fprintf(file, "%-24s chain length: %ld lookups, mean %.2f, p99 < %ld\n", e.first.c_str(), h.count(),
+				static_cast<double>(h.sum()) / h.count(), h.quantile(0.99));
+		if (e.second->rehashes.load() > 0)
+			std::fprintf(file, "%-24s rehashes: %ld\n", e.first.c_str(), e.second->rehashes.load());
+	}
+}
+
+inline bool dump_collection_metrics(const char* path, bool prometheus) {
+	std::FILE* file = std::fopen(path, "w");
+	if (!file)
+		return false;
+	MetricsRegistry& registry = MetricsRegistry::instance();
+	{
+		std::lock_guard<std::mutex> guard(registry.lock);
+		if (prometheus)
+			write_prometheus(file, registry.by_name);
+		else
+			write_summary(file, registry.by_name);
+	}
+	return std::fclose(file) == 0;
+}
+
+
+inline thread_local long OpTimer::probes = 0;
+
+inline OpTimer::OpTimer(CollectionMetrics& metrics, CollectionOp op): metrics(metrics), op(op), outer_probes(probes),
+	start(std::chrono::steady_clock::now()) {
+	probes = 0;
+}
+
+inline OpTimer::~OpTimer() {
+	std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+	metrics.ops[op].fetch_add(1, std::memory_order_relaxed);
+	metrics.probes[op].fetch_add(probes, std::memory_order_relaxed);
+	metrics.latency_ns[op].add(elapsed.count());
+	probes = outer_probes;
+}
+
+#endif
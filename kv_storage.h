@@ -0,0 +1,264 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Array of key-value pairs used by VectorCollection and
+BinSearchCollection, in one of two layouts with the same interface (pairs
+addressed by index). The columnar layout keeps the keys in their own
+contiguous array, in lockstep with an array of the values, so searches,
+range finds and keys() touch only key memory (and arithmetic keys are
+searched with the SIMD kernels in search_kernels.h). The row layout is a
+single array of pairs, which reads a found value from the cache line the
+key was on. Columnar is the default for arithmetic keys and for pairs
+bigger than a cache line; the collections take the layout as a template
+parameter to choose it either way.
+*/
+
+#ifndef KV_STORAGE_H
+#define KV_STORAGE_H
+
+#include <vector>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include "search_kernels.h"
+#include "instrumentation.h"
+
+
+// true when the columnar layout is the default for K and V
+template <typename K, typename V>
+struct columnar_by_default : std::integral_constant<bool,
+	std::is_arithmetic<K>::value || (sizeof(std::pair<K,V>) > 64)> {};
+
+
+// pairs in one array of pairs (Columnar false) or in an array of keys and
+// an array of values (Columnar true)
+template <typename K, typename V, bool Columnar = columnar_by_default<K,V>::value>
+class KVStorage {
+public:
+
+	// number of pairs
+	int size() const;
+
+	// key and value of pair i
+	const K& key(int i) const;
+	V& value(int i);
+	const V& value(int i) const;
+
+	// insert a pair before pair i (or append it) with the key forwarded
+	// from key and the value constructed in place from args
+	template <typename KArg, typename... Args>
+	void emplace(int i, KArg&& key, Args&&... args);
+	template <typename KArg, typename... Args>
+	void emplace_back(KArg&& key, Args&&... args);
+
+	// remove pair i
+	void erase(int i);
+
+	// remove every pair
+	void clear();
+
+	// make room for n pairs
+	void reserve(int n);
+
+	// exchange contents with rhs
+	void swap(KVStorage<K,V,Columnar>& rhs);
+
+	// set keys to the keys in order
+	void keys(std::vector<K>& keys) const;
+
+	// return the index of the first pair at or after from whose key is a
+	// or b, or -1
+	int find(const K& a, const K& b, int from = 0) const;
+
+	// return the index of the first pair with key >= key (size() if none),
+	// when the pairs are in ascending key order
+	int lower_bound(const K& key) const;
+
+private:
+	std::vector<std::pair<K,V>> kv_list;
+};
+
+
+// keys and values in separate arrays (pair i is key_list[i], value_list[i])
+template <typename K, typename V>
+class KVStorage<K,V,true> {
+public:
+	int size() const;
+	const K& key(int i) const;
+	V& value(int i);
+	const V& value(int i) const;
+	template <typename KArg, typename... Args>
+	void emplace(int i, KArg&& key, Args&&... args);
+	template <typename KArg, typename... Args>
+	void emplace_back(KArg&& key, Args&&... args);
+	void erase(int i);
+	void clear();
+	void reserve(int n);
+	void swap(KVStorage<K,V,true>& rhs);
+	void keys(std::vector<K>& keys) const;
+	int find(const K& a, const K& b, int from = 0) const;
+	int lower_bound(const K& key) const;
+
+private:
+	std::vector<K> key_list;
+	std::vector<V> value_list;
+};
+
+
+template <typename K, typename V, bool Columnar>
+int KVStorage<K,V,Columnar>::size() const {
+	return kv_list.size();
+}
+
+template <typename K, typename V, bool Columnar>
+const K& KVStorage<K,V,Columnar>::key(int i) const {
+	return kv_list[i].first;
+}
+
+template <typename K, typename V, bool Columnar>
+V& KVStorage<K,V,Columnar>::value(int i) {
+	return kv_list[i].second;
+}
+
+template <typename K, typename V, bool Columnar>
+const V& KVStorage<K,V,Columnar>::value(int i) const {
+	return kv_list[i].second;
+}
+
+template <typename K, typename V, bool Columnar>
+template <typename KArg, typename... Args>
+void KVStorage<K,V,Columnar>::emplace(int i, KArg&& key, Args&&... args) {
+	kv_list.emplace(kv_list.begin() + i, std::piecewise_construct, std::forward_as_tuple(std::forward<KArg>(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename K, typename V, bool Columnar>
+template <typename KArg, typename... Args>
+void KVStorage<K,V,Columnar>::emplace_back(KArg&& key, Args&&... args) {
+	kv_list.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<KArg>(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+}
+
+template <typename K, typename V, bool Columnar>
+void KVStorage<K,V,Columnar>::erase(int i) {
+	kv_list.erase(kv_list.begin() + i);
+}
+
+template <typename K, typename V, bool Columnar>
+void KVStorage<K,V,Columnar>::clear() {
+	kv_list.clear();
+}
+
+template <typename K, typename V, bool Columnar>
+void KVStorage<K,V,Columnar>::reserve(int n) {
+	kv_list.reserve(n);
+}
+
+template <typename K, typename V, bool Columnar>
+void KVStorage<K,V,Columnar>::swap(KVStorage<K,V,Columnar>& rhs) {
+	kv_list.swap(rhs.kv_list);
+}
+
+template <typename K, typename V, bool Columnar>
+void KVStorage<K,V,Columnar>::keys(std::vector<K>& ks) const {
+	ks.clear();
+	ks.reserve(kv_list.size());
+	for (const std::pair<K,V>& p : kv_list)
+		ks.push_back(p.first);
+}
+
+template <typename K, typename V, bool Columnar>
+int KVStorage<K,V,Columnar>::find(const K& a, const K& b, int from) const {
+	for (int i = from; i < size(); i++)
+		if (kv_list[i].first == a || kv_list[i].first == b) {
+			COLLECTION_PROBES(i - from + 1);
+			return i;
+		}
+	COLLECTION_PROBES(size() - from);
+	return -1;
+}
+
+template <typename K, typename V, bool Columnar>
+int KVStorage<K,V,Columnar>::lower_bound(const K& key) const {
+	return std::lower_bound(kv_list.begin(), kv_list.end(), key,
+		[](const std::pair<K,V>& p, const K& k) { return p.first < k; }) - kv_list.begin();
+}
+
+
+template <typename K, typename V>
+int KVStorage<K,V,true>::size() const {
+	return key_list.size();
+}
+
+template <typename K, typename V>
+const K& KVStorage<K,V,true>::key(int i) const {
+	return key_list[i];
+}
+
+template <typename K, typename V>
+V& KVStorage<K,V,true>::value(int i) {
+	return value_list[i];
+}
+
+template <typename K, typename V>
+const V& KVStorage<K,V,true>::value(int i) const {
+	return value_list[i];
+}
+
+template <typename K, typename V>
+template <typename KArg, typename... Args>
+void KVStorage<K,V,true>::emplace(int i, KArg&& key, Args&&... args) {
+	key_list.emplace(key_list.begin() + i, std::forward<KArg>(key));
+	value_list.emplace(value_list.begin() + i, std::forward<Args>(args)...);
+}
+
+template <typename K, typename V>
+template <typename KArg, typename... Args>
+void KVStorage<K,V,true>::emplace_back(KArg&& key, Args&&... args) {
+	key_list.emplace_back(std::forward<KArg>(key));
+	value_list.emplace_back(std::forward<Args>(args)...);
+}
+
+template <typename K, typename V>
+void KVStorage<K,V,true>::erase(int i) {
+	key_list.erase(key_list.begin() + i);
+	value_list.erase(value_list.begin() + i);
+}
+
+template <typename K, typename V>
+void KVStorage<K,V,true>::clear() {
+	key_list.clear();
+	value_list.clear();
+}
+
+template <typename K, typename V>
+void KVStorage<K,V,true>::reserve(int n) {
+	key_list.reserve(n);
+	value_list.reserve(n);
+}
+
+template <typename K, typename V>
+void KVStorage<K,V,true>::swap(KVStorage<K,V,true>& rhs) {
+	key_list.swap(rhs.key_list);
+	value_list.swap(rhs.value_list);
+}
+
+template <typename K, typename V>
+void KVStorage<K,V,true>::keys(std::vector<K>& ks) const {
+	ks.assign(key_list.begin(), key_list.end());
+}
+
+template <typename K, typename V>
+int KVStorage<K,V,true>::find(const K& a, const K& b, int from) const {
+	int i = scan_equal(key_list.data() + from, size() - from, a, b);
+	COLLECTION_PROBES(i < 0 ? size() - from : i + 1);
+	return i < 0 ? i : from + i;
+}
+
+template <typename K, typename V>
+int KVStorage<K,V,true>::lower_bound(const K& key) const {
+	return search_lower_bound(key_list.data(), size(), key);
+}
+
+#endif
@@ -1,18 +1,32 @@
 /*
 Greeley Lindberg
 10/3/19, hw4
-Description: Implementation of Collection using linked lists
+Description: Implementation of Collection using linked lists. The list is
+doubly linked and keeps the pairs in insertion order. With Indexed it also
+keeps a hash index from each key to its node, making it an insertion
+ordered map (like Java's LinkedHashMap): find() and remove() are O(1), an
+insert of a key already present replaces its value in place, and access()
+moves a pair to the back so the front is the least recently used.
 */
 
 #ifndef LINKED_LIST_COLLECTION_H
 #define LINKED_LIST_COLLECTION_H
 
 #include <vector>
+#include <utility>
 #include <algorithm>
+#include <type_traits>
 #include "collection.h"
+#include "node_allocator.h"
+#include "open_hash_table_collection.h"
+#include "instrumentation.h"
 
 
-template <typename K, typename V>
+// stands in for the hash index of a list without one
+struct NoListIndex {};
+
+
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool, bool Indexed = false>
 class LinkedListCollection : public Collection<K,V> {
 public:
 
@@ -20,23 +34,43 @@ public:
 	LinkedListCollection();
 
 	// copy a linked list
-	LinkedListCollection(const LinkedListCollection<K,V>& rhs);
+	LinkedListCollection(const LinkedListCollection<K,V,NodeAlloc,Indexed>& rhs);
 
 	// assign a linked list
-	LinkedListCollection<K,V>& operator =(const LinkedListCollection<K,V>& rhs);
+	LinkedListCollection<K,V,NodeAlloc,Indexed>& operator =(const LinkedListCollection<K,V,NodeAlloc,Indexed>& rhs);
 
 	// delete a linked list
 	~LinkedListCollection();
 
-	// insert a key-value pair into the collection
+	// insert a key-value pair at the back of the collection (when Indexed
+	// and the key is present, replace its value and leave it in place)
 	void insert(const K& key, const V& val);
 
+	// insert a key-value pair, moving the key and value into the collection
+	void insert(K&& key, V&& val);
+
+	// insert a key-value pair with the key forwarded from key and the value
+	// constructed in place from args
+	template <typename KArg, typename... Args>
+	void emplace(KArg&& key, Args&&... args);
+
 	// remove a key-value pair from the collection
 	void remove(const K& key);
 
 	// find the value associated with the key
 	bool find(const K& key, V& val) const;
 
+	// find the value associated with the key and move the pair to the
+	// back, as the most recently used
+	bool access(const K& key, V& val);
+
+	// set key and val to the pair at the front (the oldest, or least
+	// recently accessed) and return true, or return false if empty
+	bool front(K& key, V& val) const;
+
+	// remove the pair at the front
+	void pop_front();
+
 	// find the keys associated with the range
 	void find(const K& k1, const K& k2, std::vector<K>& keys) const;
 
@@ -46,28 +80,65 @@ public:
 	// return collection keys in sorted order
 	void sort(std::vector<K>& keys) const;
 
+	// sort() with the keys sorted on pool
+	void parallel_sort(std::vector<K>& keys, ThreadPool& pool) const;
+
 	// return the number of keys in collection
 	int size() const;
 
+	// call visitor on each key-value pair until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
 private:
 	// linked list node structure
 	struct Node {
+		// construct the key from k and the value from args
+		template <typename KArg, typename... Args>
+		Node(std::piecewise_construct_t, KArg&& k, Args&&... args): key(std::forward<KArg>(k)),
+			value(std::forward<Args>(args)...) {}
+		Node() {}
+
 		K key;
 		V value;
 		Node* next;
+		Node* prev;
 	};
 	Node* head;  		// pointer to first list node
 	Node* tail;  		// pointer to last list node
 	int length; 		// number of linked list nodes in list
+	NodeAlloc<Node> nodes;	// allocator for the list nodes
+
+	// the node of each key (when Indexed)
+	typename std::conditional<Indexed, OpenHashTableCollection<K,Node*>, NoListIndex>::type index;
+
+	// return the first node with the key, or nullptr
+	Node* find_node(const K& key) const;
+
+	// link ptr in at the back of the list
+	void link_back(Node* ptr);
+
+	// take ptr out of the list (leaving the node)
+	void unlink(Node* ptr);
+
+	// helper to empty the list
+	void make_empty();
 };
 
-template <typename K, typename V>
-LinkedListCollection<K,V>::LinkedListCollection() : head(nullptr), tail(nullptr), length(0) {}
 
-template <typename K, typename V>
-LinkedListCollection<K,V>::LinkedListCollection(const LinkedListCollection<K,V>& rhs): head(nullptr), tail(nullptr), length(0) {
-	Node* ptr = new Node;
-	ptr = rhs.head;
+// an insertion ordered map: the list with its hash index
+template <typename K, typename V, template <typename> class NodeAlloc = NodePool>
+using LinkedHashCollection = LinkedListCollection<K,V,NodeAlloc,true>;
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+LinkedListCollection<K,V,NodeAlloc,Indexed>::LinkedListCollection() : head(nullptr), tail(nullptr), length(0) {}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+LinkedListCollection<K,V,NodeAlloc,Indexed>::LinkedListCollection(const LinkedListCollection<K,V,NodeAlloc,Indexed>& rhs): head(nullptr), tail(nullptr), length(0) {
+	Node* ptr = rhs.head;
 	while (ptr != nullptr) {
 		insert(ptr->key, ptr->value);
 		ptr = ptr->next;
@@ -75,19 +146,12 @@ LinkedListCollection<K,V>::LinkedListCollection(const LinkedListCollection<K,V>&
 	
 }
 
-template <typename K, typename V>
-LinkedListCollection<K,V>& LinkedListCollection<K,V>::operator =(const LinkedListCollection<K,V>& rhs) {
-	Node* ptr = new Node;
-	Node* next_ptr = new Node;
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+LinkedListCollection<K,V,NodeAlloc,Indexed>& LinkedListCollection<K,V,NodeAlloc,Indexed>::operator =(const LinkedListCollection<K,V,NodeAlloc,Indexed>& rhs) {
 	if (this == &rhs)
 		return *this;
-	ptr = head;
-	while (ptr != nullptr) {
-		next_ptr = ptr->next;
-		remove(ptr->key);
-		ptr = next_ptr;
-	}
-	ptr = rhs.head;
+	make_empty();
+	Node* ptr = rhs.head;
 	while (ptr != nullptr) {
 		insert(ptr->key, ptr->value);
 		ptr = ptr->next;
@@ -95,85 +159,164 @@ LinkedListCollection<K,V>& LinkedListCollection<K,V>::operator =(const LinkedLis
 	return *this; 
 }
 
-template <typename K, typename V>
-LinkedListCollection<K,V>::~LinkedListCollection() {
-	Node* ptr = new Node;
-	Node* next_ptr = new Node;
-	ptr = head;
-	while (ptr != nullptr) {
-		next_ptr = ptr->next;
-		remove(ptr->key);
-		ptr = next_ptr;
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+LinkedListCollection<K,V,NodeAlloc,Indexed>::~LinkedListCollection() {
+	make_empty();
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::make_empty() {
+	// a pool frees all the nodes at once, so they only need to be
+	// visited if they have destructors to run
+	if (!NodeAlloc<Node>::bulk_release || !std::is_trivially_destructible<Node>::value) {
+		Node* ptr = head;
+		while (ptr != nullptr) {
+			Node* next_ptr = ptr->next;
+			nodes.destroy(ptr);
+			ptr = next_ptr;
+		}
 	}
+	nodes.release();
+	if constexpr (Indexed)
+		index = OpenHashTableCollection<K,Node*>();
+	head = nullptr;
+	tail = nullptr;
+	length = 0;
 }
 
-template <typename K, typename V>
-void LinkedListCollection<K,V>::insert(const K& key, const V& val) {
-	Node* ptr = new Node;
-	ptr->key = key;
-	ptr->value = val;
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+typename LinkedListCollection<K,V,NodeAlloc,Indexed>::Node*
+LinkedListCollection<K,V,NodeAlloc,Indexed>::find_node(const K& key) const {
+	if constexpr (Indexed) {
+		Node* ptr;
+		COLLECTION_PROBES(1);
+		return index.find(key, ptr) ? ptr : nullptr;
+	}
+	for (Node* ptr = head; ptr != nullptr; ptr = ptr->next) {
+		COLLECTION_PROBES(1);
+		if (ptr->key == key)
+			return ptr;
+	}
+	return nullptr;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::link_back(Node* ptr) {
 	ptr->next = nullptr;
-	if (!head) {
+	ptr->prev = tail;
+	if (!head)
 		head = ptr;
-	}
-	else 
+	else
 		tail->next = ptr;
 	tail = ptr;
-	length++;
 }
 
-template <typename K, typename V>
-void LinkedListCollection<K,V>::remove(const K& key) {
-	Node* ptr = new Node;
-	Node* previous = new Node;
-	if (!head)
-		return;
-	else {
-		if (head->key == key) {
-			if (head==tail)
-				tail = nullptr;
-			ptr = head->next;
-			delete head;
-			head = ptr;
-			length--;
-		}
-		else {
-			ptr = head;
-			while (ptr != nullptr && ptr->key != key) {
-				previous = ptr;
-				ptr = ptr->next;
-			}
-			if (ptr)
-				previous->next = ptr->next;
-				if (tail==ptr)
-					tail = previous;
-				delete ptr;
-				ptr = nullptr;
-				length--;
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::unlink(Node* ptr) {
+	if (ptr->prev)
+		ptr->prev->next = ptr->next;
+	else
+		head = ptr->next;
+	if (ptr->next)
+		ptr->next->prev = ptr->prev;
+	else
+		tail = ptr->prev;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::insert(const K& key, const V& val) {
+	emplace(key, val);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::insert(K&& key, V&& val) {
+	emplace(std::move(key), std::move(val));
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+template <typename KArg, typename... Args>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::emplace(KArg&& key, Args&&... args) {
+	COLLECTION_OP("LinkedList", OP_INSERT);
+	if constexpr (Indexed) {
+		Node* ptr = find_node(key);
+		if (ptr) {
+			ptr->value = V(std::forward<Args>(args)...);
+			return;
 		}
 	}
+	Node* ptr = nodes.create(std::piecewise_construct, std::forward<KArg>(key), std::forward<Args>(args)...);
+	link_back(ptr);
+	if constexpr (Indexed)
+		index.insert(ptr->key, ptr);
+	length++;
 }
 
-template <typename K, typename V>
-bool LinkedListCollection<K,V>::find(const K& key, V& val) const {
-	Node* ptr = new Node;
-	ptr = head;
-	while (ptr != nullptr) {
-		if (ptr->key == key) {
-			val = ptr->value;
-			return true;
-		}
-		ptr = ptr->next;
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::remove(const K& key) {
+	COLLECTION_OP("LinkedList", OP_REMOVE);
+	Node* ptr = find_node(key);
+	if (!ptr)
+		return;
+	if constexpr (Indexed)
+		index.remove(key);
+	unlink(ptr);
+	nodes.destroy(ptr);
+	length--;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+bool LinkedListCollection<K,V,NodeAlloc,Indexed>::find(const K& key, V& val) const {
+	COLLECTION_OP("LinkedList", OP_FIND);
+	Node* ptr = find_node(key);
+	if (!ptr)
+		return false;
+	val = ptr->value;
+	return true;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+bool LinkedListCollection<K,V,NodeAlloc,Indexed>::access(const K& key, V& val) {
+	COLLECTION_OP("LinkedList", OP_FIND);
+	Node* ptr = find_node(key);
+	if (!ptr)
+		return false;
+	if (ptr != tail) {
+		unlink(ptr);
+		link_back(ptr);
 	}
-	return false;
+	val = ptr->value;
+	return true;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+bool LinkedListCollection<K,V,NodeAlloc,Indexed>::front(K& key, V& val) const {
+	if (!head)
+		return false;
+	key = head->key;
+	val = head->value;
+	return true;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::pop_front() {
+	COLLECTION_OP("LinkedList", OP_REMOVE);
+	Node* ptr = head;
+	if (!ptr)
+		return;
+	if constexpr (Indexed)
+		index.remove(ptr->key);
+	unlink(ptr);
+	nodes.destroy(ptr);
+	length--;
 }
 
-template <typename K, typename V>
-void LinkedListCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+	COLLECTION_OP("LinkedList", OP_RANGE);
 	keys.clear();
-	Node* ptr = new Node;
-	ptr = head;
+	Node* ptr = head;
 	while (ptr != nullptr) {
+		COLLECTION_PROBES(1);
 		if (ptr->key == k1) {
 			while (ptr != nullptr) {
 				keys.push_back(ptr->key);
@@ -189,11 +332,10 @@ void LinkedListCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& k
 	return;
 }
 
-template <typename K, typename V>
-void LinkedListCollection<K,V>::keys(std::vector<K>& keys) const {
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::keys(std::vector<K>& keys) const {
 	keys.clear();
-	Node* ptr = new Node;
-	ptr = head;
+	Node* ptr = head;
 	int i = 0;
 	while (ptr != nullptr) {
 		keys.push_back(ptr->key);
@@ -202,10 +344,10 @@ void LinkedListCollection<K,V>::keys(std::vector<K>& keys) const {
 	}
 }
 
-template <typename K, typename V>
-void LinkedListCollection<K,V>::sort(std::vector <K>& keys) const {
-	Node* ptr = new Node;
-	ptr = head;
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::sort(std::vector <K>& keys) const {
+	keys.clear();
+	Node* ptr = head;
 	while (ptr != nullptr) {
 		keys.push_back(ptr->key);
 		ptr = ptr->next;
@@ -213,9 +355,30 @@ void LinkedListCollection<K,V>::sort(std::vector <K>& keys) const {
 	std::sort(keys.begin(), keys.end());
 }
 
-template <typename K, typename V>
-int LinkedListCollection<K,V>::size() const {
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::parallel_sort(std::vector <K>& ks, ThreadPool& pool) const {
+	// the list can only be walked in order, so only the sort is split up
+	keys(ks);
+	sort_in_parallel(pool, ks);
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+int LinkedListCollection<K,V,NodeAlloc,Indexed>::size() const {
 	return length;
 }
 
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	for (Node* ptr = head; ptr != nullptr; ptr = ptr->next)
+		if (!visitor(ptr->key, ptr->value))
+			return;
+}
+
+template <typename K, typename V, template <typename> class NodeAlloc, bool Indexed>
+void LinkedListCollection<K,V,NodeAlloc,Indexed>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	for (Node* ptr = head; ptr != nullptr; ptr = ptr->next)
+		if (ptr->key >= k1 && ptr->key <= k2 && !visitor(ptr->key, ptr->value))
+			return;
+}
+
 #endif
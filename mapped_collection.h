@@ -0,0 +1,158 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Read-only implementation of Collection over a snapshot file
+(see snapshot.h) mapped into memory. Opening a snapshot only maps it and
+checks the header; find() and range find binary search the mapped key
+array in place, so the pages a lookup touches are read in on first use and
+nothing is built per key. The collection is read only: insert and remove
+are errors and assert.
+*/
+
+#ifndef MAPPED_COLLECTION_H
+#define MAPPED_COLLECTION_H
+
+#include <vector>
+#include <cassert>
+#include "collection.h"
+#include "snapshot.h"
+#include "search_kernels.h"
+#include "instrumentation.h"
+
+
+// a read only Collection: insert and remove are not supported and assert
+template <typename K, typename V>
+class MappedCollection : public Collection<K,V> {
+public:
+
+	// create an empty collection (no snapshot mapped)
+	MappedCollection();
+
+	// map the snapshot at path in place of the current one and return true,
+	// or return false (leaving the collection empty) if it is not a
+	// snapshot of K and V
+	bool open(const char* path);
+
+	// unmap the snapshot, leaving the collection empty
+	void close();
+
+	// not supported (the collection is read only); asserts
+	void insert(const K& key, const V& val);
+
+	// not supported (the collection is read only); asserts
+	void remove(const K& key);
+
+	// find the value associated with the key
+	bool find(const K& key, V& val) const;
+
+	// find the keys associated with the range
+	void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+	// return all keys in the collection
+	void keys(std::vector<K>& keys) const;
+
+	// return collection keys in sorted order
+	void sort(std::vector<K>& keys) const;
+
+	// return the number of keys in collection
+	int size() const;
+
+	// call visitor on each key-value pair in ascending key order until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2 in ascending key order
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+private:
+
+	// the mapped snapshot
+	SnapshotFile<K,V> file;
+};
+
+
+template <typename K, typename V>
+MappedCollection<K,V>::MappedCollection() {}
+
+template <typename K, typename V>
+bool MappedCollection<K,V>::open(const char* path) {
+	return file.open(path);
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::close() {
+	file.close();
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::insert(const K&, const V&) {
+	assert(false && "MappedCollection is read only");
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::remove(const K&) {
+	assert(false && "MappedCollection is read only");
+}
+
+template <typename K, typename V>
+bool MappedCollection<K,V>::find(const K& key, V& val) const {
+	COLLECTION_OP("Mapped", OP_FIND);
+	int n = file.size();
+	if (n == 0)
+		return false;
+	COLLECTION_PROBES(binary_search_probes(n));
+	int i = search_lower_bound(file.keys(), n, key);
+	if (i == n || !(file.keys()[i] == key))
+		return false;
+	val = file.values()[i];
+	return true;
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& ks) const {
+	COLLECTION_OP("Mapped", OP_RANGE);
+	ks.clear();
+	int n = file.size();
+	if (n == 0)
+		return;
+	for (int i = search_lower_bound(file.keys(), n, k1); i < n && file.keys()[i] <= k2; i++)
+		ks.push_back(file.keys()[i]);
+	COLLECTION_PROBES(binary_search_probes(n) + ks.size());
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::keys(std::vector<K>& ks) const {
+	ks.clear();
+	if (file.size() > 0)
+		ks.assign(file.keys(), file.keys() + file.size());
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::sort(std::vector<K>& ks) const {
+	// the snapshot is in key order
+	keys(ks);
+}
+
+template <typename K, typename V>
+int MappedCollection<K,V>::size() const {
+	return file.size();
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	for (int i = 0; i < file.size(); i++)
+		if (!visitor(file.keys()[i], file.values()[i]))
+			return;
+}
+
+template <typename K, typename V>
+void MappedCollection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	int n = file.size();
+	if (n == 0)
+		return;
+	for (int i = search_lower_bound(file.keys(), n, k1); i < n && file.keys()[i] <= k2; i++)
+		if (!visitor(file.keys()[i], file.values()[i]))
+			return;
+}
+
+#endif
@@ -0,0 +1,216 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Node allocators for the node based collections. A collection
+takes the allocator as a template parameter and keeps one for its nodes:
+
+	NodePool          - nodes are carved out of large slabs and freed nodes
+	                    go on a free list, so create/destroy never call
+	                    malloc/free and release() frees every node at once
+	NewNodeAllocator  - each node is a separate new/delete (the old
+	                    behavior)
+
+Both provide create() (optionally with constructor arguments),
+destroy(ptr), release(), swap(rhs) and bulk_release (true when release()
+frees the memory of every node still alive, so a collection can skip
+visiting its nodes when they have nothing to destruct).
+*/
+
+#ifndef NODE_ALLOCATOR_H
+#define NODE_ALLOCATOR_H
+
+#include <vector>
+#include <new>
+#include <utility>
+
+
+template <typename T>
+class NodePool {
+public:
+
+	// create an empty pool
+	NodePool();
+
+	// copying a collection gives the copy its own empty pool
+	NodePool(const NodePool<T>& rhs);
+
+	// assigning a collection keeps each pool with its own nodes
+	NodePool<T>& operator =(const NodePool<T>& rhs);
+
+	// free every slab
+	~NodePool();
+
+	// return a default constructed node
+	T* create();
+
+	// return a node constructed from args
+	template <typename... Args>
+	T* create(Args&&... args);
+
+	// destruct a node and put its memory on the free list
+	void destroy(T* ptr);
+
+	// free the memory of every node at once (nodes are not destructed)
+	void release();
+
+	// exchange nodes with another pool (for moving a collection)
+	void swap(NodePool<T>& rhs);
+
+	// release() frees every node
+	static const bool bulk_release = true;
+
+private:
+
+	// return memory for one node
+	void* allocate();
+
+	// a free node's memory holds the next free node
+	union Slot {
+		Slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	// slab sizes double from the first up to the largest
+	static const int first_slab_slots = 32;
+	static const int max_slab_slots = 4096;
+
+	// every slab allocated so far
+	std::vector<Slot*> slabs;
+
+	// freed nodes available for reuse
+	Slot* free_list;
+
+	// next never used slot in the newest slab and the end of that slab
+	Slot* next_slot;
+	Slot* slab_end;
+
+	// number of slots in the next slab allocated
+	int slab_slots;
+};
+
+
+template <typename T>
+class NewNodeAllocator {
+public:
+
+	// return a default constructed node
+	T* create();
+
+	// return a node constructed from args
+	template <typename... Args>
+	T* create(Args&&... args);
+
+	// destruct and free a node
+	void destroy(T* ptr);
+
+	// nothing to free (every node has been destroyed already)
+	void release();
+
+	// nothing to exchange (nodes belong to the heap, not the allocator)
+	void swap(NewNodeAllocator<T>& rhs);
+
+	// release() does not free the nodes
+	static const bool bulk_release = false;
+};
+
+
+template <typename T>
+NodePool<T>::NodePool(): free_list(nullptr), next_slot(nullptr), slab_end(nullptr), slab_slots(first_slab_slots) {}
+
+template <typename T>
+NodePool<T>::NodePool(const NodePool<T>& rhs): free_list(nullptr), next_slot(nullptr), slab_end(nullptr),
+	slab_slots(first_slab_slots) {}
+
+template <typename T>
+NodePool<T>& NodePool<T>::operator =(const NodePool<T>& rhs) {
+	return *this;
+}
+
+template <typename T>
+NodePool<T>::~NodePool() {
+	release();
+}
+
+template <typename T>
+T* NodePool<T>::create() {
+	return new (allocate()) T;
+}
+
+template <typename T>
+template <typename... Args>
+T* NodePool<T>::create(Args&&... args) {
+	return new (allocate()) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+void* NodePool<T>::allocate() {
+	Slot* slot;
+	if (free_list) {
+		slot = free_list;
+		free_list = free_list->next;
+	}
+	else {
+		if (next_slot == slab_end) {
+			next_slot = new Slot[slab_slots];
+			slabs.push_back(next_slot);
+			slab_end = next_slot + slab_slots;
+			if (slab_slots < max_slab_slots)
+				slab_slots *= 2;
+		}
+		slot = next_slot++;
+	}
+	return slot->storage;
+}
+
+template <typename T>
+void NodePool<T>::destroy(T* ptr) {
+	ptr->~T();
+	Slot* slot = reinterpret_cast<Slot*>(ptr);
+	slot->next = free_list;
+	free_list = slot;
+}
+
+template <typename T>
+void NodePool<T>::release() {
+	for (Slot* slab : slabs)
+		delete[] slab;
+	slabs.clear();
+	free_list = nullptr;
+	next_slot = nullptr;
+	slab_end = nullptr;
+	slab_slots = first_slab_slots;
+}
+
+template <typename T>
+void NodePool<T>::swap(NodePool<T>& rhs) {
+	slabs.swap(rhs.slabs);
+	std::swap(free_list, rhs.free_list);
+	std::swap(next_slot, rhs.next_slot);
+	std::swap(slab_end, rhs.slab_end);
+	std::swap(slab_slots, rhs.slab_slots);
+}
+
+
+template <typename T>
+T* NewNodeAllocator<T>::create() {
+	return new T;
+}
+
+template <typename T>
+template <typename... Args>
+T* NewNodeAllocator<T>::create(Args&&... args) {
+	return new T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+void NewNodeAllocator<T>::destroy(T* ptr) {
+	delete ptr;
+}
+
+template <typename T>
+void NewNodeAllocator<T>::release() {}
+
+template <typename T>
+void NewNodeAllocator<T>::swap(NewNodeAllocator<T>& rhs) {}
+
+#endif
@@ -0,0 +1,488 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Implementation of Collection using an open addressing hash
+table. Keys and values live in one flat slot array and a parallel array of
+one byte control codes records whether each slot is empty, deleted, or full
+(in which case it holds 7 bits of the key's hash). Lookups scan the control
+bytes a group of 16 at a time and only touch a slot when its control byte
+matches, so a find() is usually a single cache line of control bytes plus
+the slot holding the key.
+*/
+
+#ifndef OPEN_HASH_TABLE_COLLECTION_H
+#define OPEN_HASH_TABLE_COLLECTION_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "collection.h"
+#include "instrumentation.h"
+
+template <typename K, typename V>
+class OpenHashTableCollection: public Collection<K,V> {
+	public:
+		// create an empty hash table
+		OpenHashTableCollection();
+
+		// copy a hash table
+		OpenHashTableCollection(const OpenHashTableCollection<K,V>& rhs);
+
+		// assign a hash table
+		OpenHashTableCollection<K,V>& operator =(const OpenHashTableCollection<K,V>& rhs);
+
+		// delete a hash table
+		~OpenHashTableCollection();
+
+		// insert a key-value pair into the collection (replaces the
+		// value if the key is already present)
+		void insert(const K& key, const V& val);
+
+		// remove a key-value pair from the collection
+		void remove(const K& key);
+
+		// find the value associated with the key
+		bool find(const K& key, V& val) const;
+
+		// find the keys associated with the range
+		void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+		// find the values of keys[0..n-1], prefetching the control groups
+		// and then the matching slots of a group of keys before probing
+		void find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const;
+
+		// return all keys in the collection
+		void keys(std::vector<K>& keys) const;
+
+		// return collection keys in sorted order
+		void sort(std::vector<K>& keys) const;
+
+		// keys(), sort() and find(k1, k2, keys) with the slots scanned on pool
+		void parallel_keys(std::vector<K>& keys, ThreadPool& pool) const;
+		void parallel_sort(std::vector<K>& keys, ThreadPool& pool) const;
+		void parallel_find(const K& k1, const K& k2, std::vector<K>& keys, ThreadPool& pool) const;
+
+		// return the number of keys in collection
+		int size() const;
+
+		// call visitor on each key-value pair until it returns false
+		void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+		// call visitor on each key-value pair with k1 <= key <= k2
+		// until it returns false
+		void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	private:
+		// key-value slot type
+		typedef std::pair<K,V> Slot;
+
+		// control byte values (full slots hold a 7 bit hash in 0..127)
+		static const signed char EMPTY = -128;
+		static const signed char DELETED = -2;
+
+		// number of control bytes scanned at a time
+		static const int GROUP_WIDTH = 16;
+
+		// bit mask of the slots in group g whose control byte is h2
+		unsigned int match(int g, signed char h2) const;
+
+		// bit mask of the empty slots in group g
+		unsigned int match_empty(int g) const;
+
+		// bit mask of the empty or deleted slots in group g
+		unsigned int match_empty_or_deleted(int g) const;
+
+		// hash a key (mixed so both halves of the hash are usable)
+		static size_t hash(const K& key);
+
+		// return the slot index holding key, or -1 if not present
+		int find_index(const K& key, size_t h) const;
+
+		// return the first empty or deleted slot in the probe sequence
+		int find_insert_index(size_t h) const;
+
+		// allocate empty control and slot arrays of the given capacity
+		void allocate(int capacity);
+
+		// helper to empty entire hash table
+		void make_empty();
+
+		// grow the table (or just clear out deleted slots) and rehash
+		void resize_and_rehash();
+
+		// set keys to the keys that pass pred, in slot order, scanning runs
+		// of slots on pool
+		template <typename Pred>
+		void scan_in_parallel(Pred pred, std::vector<K>& keys, ThreadPool& pool) const;
+
+		// number of k-v pairs in the collection
+		int collection_size;
+
+		// number of slots (a power of two, multiple of GROUP_WIDTH)
+		int table_capacity;
+
+		// number of inserts allowed into empty slots before a rehash
+		// (keeps the load factor at or below 7/8)
+		int growth_left;
+
+		// control byte array (one per slot)
+		signed char* ctrl;
+
+		// flat key-value slot array
+		Slot* slots;
+};
+
+
+template <typename K, typename V>
+OpenHashTableCollection<K,V>::OpenHashTableCollection(): collection_size(0), table_capacity(0), growth_left(0),
+	ctrl(nullptr), slots(nullptr) {
+	allocate(GROUP_WIDTH);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::allocate(int capacity) {
+	table_capacity = capacity;
+	ctrl = new signed char[capacity];
+	std::memset(ctrl, EMPTY, capacity);
+	slots = static_cast<Slot*>(::operator new(sizeof(Slot) * capacity));
+	growth_left = capacity - capacity / 8;
+	collection_size = 0;
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::make_empty() {
+	// make sure hash table exists
+	if (!ctrl)
+		return;
+	for (int i = 0; i < table_capacity; i++)
+		if (ctrl[i] >= 0)
+			slots[i].~Slot();
+	delete[] ctrl;
+	::operator delete(slots);
+	ctrl = nullptr;
+	slots = nullptr;
+	collection_size = 0;
+}
+
+template <typename K, typename V>
+OpenHashTableCollection<K,V>::~OpenHashTableCollection() {
+	make_empty();
+}
+
+template <typename K, typename V>
+OpenHashTableCollection<K,V>::OpenHashTableCollection(const OpenHashTableCollection<K,V>& rhs):
+	collection_size(0), table_capacity(0), growth_left(0), ctrl(nullptr), slots(nullptr) {
+	*this = rhs;
+}
+
+template <typename K, typename V>
+OpenHashTableCollection<K,V>& OpenHashTableCollection<K,V>::operator=(const OpenHashTableCollection<K,V>& rhs) {
+	// check if rhs is current object and return current object
+	if (this == &rhs)
+		return *this;
+	// delete current object
+	make_empty();
+	// copy slot for slot (same capacity means the same positions)
+	allocate(rhs.table_capacity);
+	for (int i = 0; i < table_capacity; i++) {
+		if (rhs.ctrl[i] >= 0)
+			new (&slots[i]) Slot(rhs.slots[i]);
+		ctrl[i] = rhs.ctrl[i];
+	}
+	collection_size = rhs.collection_size;
+	growth_left = rhs.growth_left;
+	return *this;
+}
+
+template <typename K, typename V>
+size_t OpenHashTableCollection<K,V>::hash(const K& key) {
+	std::hash<K> hash_fun;
+	uint64_t h = hash_fun(key);
+	// std::hash is the identity for integers, so mix the bits
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+template <typename K, typename V>
+unsigned int OpenHashTableCollection<K,V>::match(int g, signed char h2) const {
+#ifdef __SSE2__
+	__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl + g * GROUP_WIDTH));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group));
+#else
+	unsigned int mask = 0;
+	const signed char* group = ctrl + g * GROUP_WIDTH;
+	for (int i = 0; i < GROUP_WIDTH; i++)
+		if (group[i] == h2)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+template <typename K, typename V>
+unsigned int OpenHashTableCollection<K,V>::match_empty(int g) const {
+	return match(g, EMPTY);
+}
+
+template <typename K, typename V>
+unsigned int OpenHashTableCollection<K,V>::match_empty_or_deleted(int g) const {
+#ifdef __SSE2__
+	// empty and deleted are the only negative control bytes
+	__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl + g * GROUP_WIDTH));
+	return _mm_movemask_epi8(group);
+#else
+	unsigned int mask = 0;
+	const signed char* group = ctrl + g * GROUP_WIDTH;
+	for (int i = 0; i < GROUP_WIDTH; i++)
+		if (group[i] < 0)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+template <typename K, typename V>
+int OpenHashTableCollection<K,V>::find_index(const K& key, size_t h) const {
+	int group_mask = table_capacity / GROUP_WIDTH - 1;
+	signed char h2 = h & 0x7f;
+	int g = (h >> 7) & group_mask;
+	// quadratic probe over groups; stop at the first group with an
+	// empty slot since the key would have been placed there
+	for (int step = 1; ; step++) {
+		unsigned int bits = match(g, h2);
+		while (bits) {
+			int i = g * GROUP_WIDTH + __builtin_ctz(bits);
+			COLLECTION_PROBES(1);
+			if (slots[i].first == key) {
+				COLLECTION_CHAIN("OpenHashTable", step);
+				return i;
+			}
+			bits &= bits - 1;
+		}
+		if (match_empty(g)) {
+			COLLECTION_CHAIN("OpenHashTable", step);
+			return -1;
+		}
+		g = (g + step) & group_mask;
+	}
+}
+
+template <typename K, typename V>
+int OpenHashTableCollection<K,V>::find_insert_index(size_t h) const {
+	int group_mask = table_capacity / GROUP_WIDTH - 1;
+	int g = (h >> 7) & group_mask;
+	for (int step = 1; ; step++) {
+		unsigned int bits = match_empty_or_deleted(g);
+		if (bits)
+			return g * GROUP_WIDTH + __builtin_ctz(bits);
+		g = (g + step) & group_mask;
+	}
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::resize_and_rehash() {
+	COLLECTION_REHASH("OpenHashTable");
+	signed char* old_ctrl = ctrl;
+	Slot* old_slots = slots;
+	int old_capacity = table_capacity;
+	int old_size = collection_size;
+	// double the table unless most of the used slots are just deleted
+	// markers, in which case rehashing at the same size clears them out
+	int new_capacity = old_capacity;
+	if (old_size * 2 >= old_capacity - old_capacity / 8)
+		new_capacity = old_capacity * 2;
+	allocate(new_capacity);
+	// move each key-value pair into the new slots
+	for (int i = 0; i < old_capacity; i++) {
+		if (old_ctrl[i] >= 0) {
+			size_t h = hash(old_slots[i].first);
+			int j = find_insert_index(h);
+			new (&slots[j]) Slot(std::move(old_slots[i]));
+			ctrl[j] = h & 0x7f;
+			old_slots[i].~Slot();
+		}
+	}
+	collection_size = old_size;
+	growth_left -= old_size;
+	delete[] old_ctrl;
+	::operator delete(old_slots);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::insert(const K& key, const V& val) {
+	COLLECTION_OP("OpenHashTable", OP_INSERT);
+	size_t h = hash(key);
+	int i = find_index(key, h);
+	if (i >= 0) {
+		slots[i].second = val;
+		return;
+	}
+	i = find_insert_index(h);
+	// only filling an empty slot uses up growth (deleted slots are reused)
+	if (ctrl[i] == EMPTY && growth_left == 0) {
+		resize_and_rehash();
+		i = find_insert_index(h);
+	}
+	if (ctrl[i] == EMPTY)
+		growth_left--;
+	new (&slots[i]) Slot(key, val);
+	ctrl[i] = h & 0x7f;
+	collection_size++;
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::remove(const K& key) {
+	COLLECTION_OP("OpenHashTable", OP_REMOVE);
+	if (collection_size == 0)
+		return;
+	int i = find_index(key, hash(key));
+	if (i < 0)
+		return;
+	slots[i].~Slot();
+	// if the group still has an empty slot no probe sequence continues
+	// past it, so the slot can go straight back to empty
+	if (match_empty(i / GROUP_WIDTH)) {
+		ctrl[i] = EMPTY;
+		growth_left++;
+	}
+	else
+		ctrl[i] = DELETED;
+	collection_size--;
+}
+
+template <typename K, typename V>
+bool OpenHashTableCollection<K,V>::find(const K& key, V& val) const {
+	COLLECTION_OP("OpenHashTable", OP_FIND);
+	if (collection_size == 0)
+		return false;
+	int i = find_index(key, hash(key));
+	if (i < 0)
+		return false;
+	val = slots[i].second;
+	return true;
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::find_batch(const K* keys, int n, V* vals, std::vector<bool>& found) const {
+	found.assign(n, false);
+	if (collection_size == 0)
+		return;
+
+	int group_mask = table_capacity / GROUP_WIDTH - 1;
+	size_t hashes[batch_group_size];
+	for (int base = 0; base < n; base += batch_group_size) {
+		int group = std::min(batch_group_size, n - base);
+		// stage 1: hash the keys and prefetch their first control group
+		for (int j = 0; j < group; j++) {
+			hashes[j] = hash(keys[base + j]);
+			__builtin_prefetch(ctrl + ((hashes[j] >> 7) & group_mask) * GROUP_WIDTH);
+		}
+		// stage 2: prefetch the first slot whose control byte matches
+		for (int j = 0; j < group; j++) {
+			int g = (hashes[j] >> 7) & group_mask;
+			unsigned int bits = match(g, hashes[j] & 0x7f);
+			if (bits)
+				__builtin_prefetch(&slots[g * GROUP_WIDTH + __builtin_ctz(bits)]);
+		}
+		// stage 3: probe
+		for (int j = 0; j < group; j++) {
+			int i = find_index(keys[base + j], hashes[j]);
+			if (i >= 0) {
+				vals[base + j] = slots[i].second;
+				found[base + j] = true;
+			}
+		}
+	}
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& keys) const {
+	COLLECTION_OP("OpenHashTable", OP_RANGE);
+	COLLECTION_PROBES(collection_size);
+	keys.clear();
+	for (int i = 0; i < table_capacity; i++)
+		if (ctrl[i] >= 0 && slots[i].first >= k1 && slots[i].first <= k2)
+			keys.push_back(slots[i].first);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::keys(std::vector<K>& keys) const {
+	keys.clear();
+	keys.reserve(collection_size);
+	for (int i = 0; i < table_capacity; i++)
+		if (ctrl[i] >= 0)
+			keys.push_back(slots[i].first);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::sort(std::vector<K>& ks) const {
+	keys(ks);
+	std::sort(ks.begin(), ks.end());
+}
+
+template <typename K, typename V>
+template <typename Pred>
+void OpenHashTableCollection<K,V>::scan_in_parallel(Pred pred, std::vector<K>& ks, ThreadPool& pool) const {
+	int pieces = parallel_pieces(pool);
+	std::vector<std::vector<K>> parts(pieces);
+	parallel_for(pool, pieces, [&](int p) {
+		int end = static_cast<long long>(table_capacity) * (p + 1) / pieces;
+		for (int i = static_cast<long long>(table_capacity) * p / pieces; i < end; i++)
+			if (ctrl[i] >= 0 && pred(slots[i].first))
+				parts[p].push_back(slots[i].first);
+	});
+	concat_in_parallel(pool, parts, ks);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::parallel_keys(std::vector<K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		keys(ks);
+		return;
+	}
+	scan_in_parallel([](const K&) { return true; }, ks, pool);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::parallel_sort(std::vector<K>& ks, ThreadPool& pool) const {
+	parallel_keys(ks, pool);
+	sort_in_parallel(pool, ks);
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::parallel_find(const K& k1, const K& k2, std::vector<K>& ks, ThreadPool& pool) const {
+	if (pool.size() == 0 || collection_size < parallel_min_items) {
+		find(k1, k2, ks);
+		return;
+	}
+	scan_in_parallel([&k1, &k2](const K& key) { return key >= k1 && key <= k2; }, ks, pool);
+}
+
+template <typename K, typename V>
+int OpenHashTableCollection<K,V>::size() const {
+	return collection_size;
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	for (int i = 0; i < table_capacity; i++)
+		if (ctrl[i] >= 0 && !visitor(slots[i].first, slots[i].second))
+			return;
+}
+
+template <typename K, typename V>
+void OpenHashTableCollection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	for (int i = 0; i < table_capacity; i++)
+		if (ctrl[i] >= 0 && slots[i].first >= k1 && slots[i].first <= k2 &&
+		    !visitor(slots[i].first, slots[i].second))
+			return;
+}
+
+#endif
@@ -0,0 +1,458 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Implementation of Collection using a packed memory array: a
+sorted array with gaps spread through it, so an insert or remove shifts a
+few keys instead of the whole tail like BinSearchCollection does. The slots
+are split into segments of about 2 log n slots; each segment keeps its pairs
+at its front, in ascending key order across the segments. A lookup binary
+searches the first keys of the segments, then the one segment, and a range
+find is a scan of consecutive slots. When a segment fills up (or runs
+nearly empty) the pairs of the smallest enclosing window of 2, 4, 8, ...
+segments that is within its density bounds are spread out evenly over it,
+and when no window is, the array is rebuilt at twice (or half) the size.
+That makes insert and remove O(log^2 n) amortized.
+*/
+
+#ifndef PACKED_ARRAY_COLLECTION_H
+#define PACKED_ARRAY_COLLECTION_H
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include "collection.h"
+#include "bulk_load.h"
+#include "search_kernels.h"
+#include "instrumentation.h"
+
+
+template <typename K, typename V>
+class PackedArrayCollection : public Collection<K,V> {
+public:
+
+	// create an empty collection
+	PackedArrayCollection();
+
+	// insert a key-value pair into the collection
+	void insert(const K& key, const V& val);
+
+	// insert a key-value pair, moving the key and value into the collection
+	void insert(K&& key, V&& val);
+
+	// insert a key-value pair with the key forwarded from key and the value
+	// constructed from args
+	template <typename KArg, typename... Args>
+	void emplace(KArg&& key, Args&&... args);
+
+	// remove a key-value pair from the collection
+	void remove(const K& key);
+
+	// find the value associated with the key
+	bool find(const K& key, V& val) const;
+
+	// find the keys associated with the range
+	void find(const K& k1, const K& k2, std::vector <K>& keys) const;
+
+	// return all keys in the collection
+	void keys(std::vector <K>& keys) const;
+
+	// return collection keys in sorted order
+	void sort(std::vector <K>& keys) const;
+
+	// return the number of keys in collection
+	int size() const;
+
+	// call visitor on each key-value pair in ascending key order until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2 in ascending key order
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// replace the contents with the key-value pairs in [begin, end) (linear
+	// time when the keys are already ascending)
+	template <typename Iter>
+	void bulk_load(Iter begin, Iter end);
+
+	// return the number of slots (pairs and gaps)
+	int capacity() const;
+
+private:
+
+	// fewest slots in a segment
+	static const int min_segment_size = 16;
+
+	// density bounds of a window of segments, from a single segment (level
+	// 0) up to the whole array (level height): a window is spread out when
+	// it is above its upper bound after an insert, or below its lower bound
+	// after a remove (the bounds tighten toward the root, so a spread window
+	// is well inside the bounds of the windows it contains)
+	double upper_density(int level) const;
+	double lower_density(int level) const;
+
+	// set segment and index to the first pair with key >= key (index is
+	// counts[segment] at the end of the last segment when there is none)
+	void lower_bound(const K& key, int& segment, int& index) const;
+
+	// insert the pair at its place in key order
+	void insert_pair(K&& key, V&& val);
+
+	// spread the pairs of the width segments from first evenly over them,
+	// first putting key and val (unless null) in at index at of the window's
+	// pairs
+	void spread(int first, int width, int at, K* key, V* val);
+
+	// lay out ks and vs (in ascending key order) at half density in an
+	// array sized for them
+	void rebuild(std::vector<K>& ks, std::vector<V>& vs);
+
+	// move every pair out to ks and vs in order, with key and val (unless
+	// null) put in at index at, and lay them out again sized to fit
+	void resize(int at, K* key, V* val);
+
+	// the slots, segment_size per segment (slot i of segment s is
+	// s * segment_size + i); keys and values are kept apart so searches
+	// only touch key memory
+	std::vector<K> key_slots;
+	std::vector<V> value_slots;
+
+	// number of pairs at the front of each segment
+	std::vector<int> counts;
+
+	// first key of each segment (searched to find the segment of a key)
+	std::vector<K> heads;
+
+	// slots per segment (a power of two) and levels of windows above the
+	// segments (there are 2^height segments)
+	int segment_size;
+	int height;
+
+	// number of k-v pairs in the collection
+	int collection_size;
+};
+
+
+template <typename K, typename V>
+PackedArrayCollection<K,V>::PackedArrayCollection(): segment_size(min_segment_size), height(0), collection_size(0) {
+	key_slots.resize(segment_size);
+	value_slots.resize(segment_size);
+	counts.assign(1, 0);
+	heads.resize(1);
+}
+
+template <typename K, typename V>
+double PackedArrayCollection<K,V>::upper_density(int level) const {
+	return height == 0 ? 1.0 : 1.0 - 0.25 * level / height;
+}
+
+template <typename K, typename V>
+double PackedArrayCollection<K,V>::lower_density(int level) const {
+	return height == 0 ? 0.0 : 0.125 + 0.125 * level / height;
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::lower_bound(const K& key, int& segment, int& index) const {
+	int segments = counts.size();
+	COLLECTION_PROBES(binary_search_probes(segments));
+	// the first segment whose first key is >= key; the pair is in the one
+	// before it, or is that first key
+	int next = collection_size == 0 ? 0 : search_lower_bound(heads.data(), segments, key);
+	segment = next == 0 ? 0 : next - 1;
+	COLLECTION_PROBES(binary_search_probes(counts[segment]));
+	index = next == 0 ? 0 : search_lower_bound(key_slots.data() + segment * segment_size, counts[segment], key);
+	if (index == counts[segment] && next < segments) {
+		segment = next;
+		index = 0;
+	}
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::insert(const K& key, const V& val) {
+	COLLECTION_OP("PackedArray", OP_INSERT);
+	insert_pair(K(key), V(val));
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::insert(K&& key, V&& val) {
+	COLLECTION_OP("PackedArray", OP_INSERT);
+	insert_pair(std::move(key), std::move(val));
+}
+
+template <typename K, typename V>
+template <typename KArg, typename... Args>
+void PackedArrayCollection<K,V>::emplace(KArg&& key, Args&&... args) {
+	COLLECTION_OP("PackedArray", OP_INSERT);
+	insert_pair(K(std::forward<KArg>(key)), V(std::forward<Args>(args)...));
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::insert_pair(K&& key, V&& val) {
+	int s = 0;
+	int i = 0;
+	lower_bound(key, s, i);
+	collection_size++;
+	if (counts[s] < segment_size) {
+		// room in the segment, so shift the pairs after i along one slot
+		K* ks = key_slots.data() + s * segment_size;
+		V* vs = value_slots.data() + s * segment_size;
+		std::move_backward(ks + i, ks + counts[s], ks + counts[s] + 1);
+		std::move_backward(vs + i, vs + counts[s], vs + counts[s] + 1);
+		ks[i] = std::move(key);
+		vs[i] = std::move(val);
+		counts[s]++;
+		if (i == 0)
+			heads[s] = ks[0];
+		return;
+	}
+	// the segment is full: spread the smallest window around it that has
+	// room for the pair under its bound
+	for (int level = 1; level <= height; level++) {
+		int width = 1 << level;
+		int first = s & ~(width - 1);
+		long pairs = 0;
+		int at = i;
+		for (int t = first; t < first + width; t++) {
+			pairs += counts[t];
+			if (t < s)
+				at += counts[t];
+		}
+		if (pairs + 1 <= upper_density(level) * width * segment_size) {
+			spread(first, width, at, &key, &val);
+			return;
+		}
+	}
+	// the whole array is too full
+	int at = i;
+	for (int t = 0; t < s; t++)
+		at += counts[t];
+	resize(at, &key, &val);
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::remove(const K& key) {
+	COLLECTION_OP("PackedArray", OP_REMOVE);
+	int s = 0;
+	int i = 0;
+	lower_bound(key, s, i);
+	if (i == counts[s] || !(key_slots[s * segment_size + i] == key))
+		return;
+	K* ks = key_slots.data() + s * segment_size;
+	V* vs = value_slots.data() + s * segment_size;
+	std::move(ks + i + 1, ks + counts[s], ks + i);
+	std::move(vs + i + 1, vs + counts[s], vs + i);
+	counts[s]--;
+	collection_size--;
+	if (i == 0 && counts[s] > 0)
+		heads[s] = ks[0];
+	if (counts[s] >= lower_density(0) * segment_size)
+		return;
+	// the segment is nearly empty: spread the smallest window around it
+	// that is dense enough
+	for (int level = 1; level <= height; level++) {
+		int width = 1 << level;
+		int first = s & ~(width - 1);
+		long pairs = 0;
+		for (int t = first; t < first + width; t++)
+			pairs += counts[t];
+		if (pairs >= lower_density(level) * width * segment_size) {
+			spread(first, width, 0, nullptr, nullptr);
+			return;
+		}
+	}
+	// the whole array is too empty
+	resize(0, nullptr, nullptr);
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::spread(int first, int width, int at, K* key, V* val) {
+	K* ks = key_slots.data() + first * segment_size;
+	V* vs = value_slots.data() + first * segment_size;
+	// pack the window's pairs to its front (each pair moves down, so none
+	// is overwritten before it moves)
+	int pairs = 0;
+	for (int t = first; t < first + width; t++)
+		for (int j = 0; j < counts[t]; j++, pairs++) {
+			int from = (t - first) * segment_size + j;
+			if (from != pairs) {
+				ks[pairs] = std::move(ks[from]);
+				vs[pairs] = std::move(vs[from]);
+			}
+		}
+	if (key) {
+		std::move_backward(ks + at, ks + pairs, ks + pairs + 1);
+		std::move_backward(vs + at, vs + pairs, vs + pairs + 1);
+		ks[at] = std::move(*key);
+		vs[at] = std::move(*val);
+		pairs++;
+	}
+	// then deal them out evenly from the back (each pair moves up)
+	for (int t = width - 1; t >= 0; t--) {
+		int begin = static_cast<long>(t) * pairs / width;
+		int end = static_cast<long>(t + 1) * pairs / width;
+		for (int j = end - 1; j >= begin; j--) {
+			int to = t * segment_size + j - begin;
+			if (to != j) {
+				ks[to] = std::move(ks[j]);
+				vs[to] = std::move(vs[j]);
+			}
+		}
+		counts[first + t] = end - begin;
+		if (end > begin)
+			heads[first + t] = ks[t * segment_size];
+	}
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::resize(int at, K* key, V* val) {
+	int n = collection_size;
+	std::vector<K> ks;
+	std::vector<V> vs;
+	ks.reserve(n);
+	vs.reserve(n);
+	for (int s = 0; s < (int) counts.size(); s++)
+		for (int j = 0; j < counts[s]; j++) {
+			if (key && (int) ks.size() == at) {
+				ks.push_back(std::move(*key));
+				vs.push_back(std::move(*val));
+			}
+			ks.push_back(std::move(key_slots[s * segment_size + j]));
+			vs.push_back(std::move(value_slots[s * segment_size + j]));
+		}
+	if (key && (int) ks.size() == at) {
+		ks.push_back(std::move(*key));
+		vs.push_back(std::move(*val));
+	}
+	rebuild(ks, vs);
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::rebuild(std::vector<K>& ks, std::vector<V>& vs) {
+	int n = ks.size();
+	// segments of about 2 log n slots, as many as leave them half full
+	segment_size = min_segment_size;
+	while (segment_size < 2 * binary_search_probes(n))
+		segment_size *= 2;
+	int segments = 1;
+	height = 0;
+	while (n > static_cast<long>(segments) * segment_size / 2) {
+		segments *= 2;
+		height++;
+	}
+	key_slots.assign(static_cast<size_t>(segments) * segment_size, K());
+	value_slots.assign(static_cast<size_t>(segments) * segment_size, V());
+	counts.assign(segments, 0);
+	heads.assign(segments, K());
+	for (int t = 0; t < segments; t++) {
+		int begin = static_cast<long>(t) * n / segments;
+		int end = static_cast<long>(t + 1) * n / segments;
+		std::move(ks.begin() + begin, ks.begin() + end, key_slots.begin() + t * segment_size);
+		std::move(vs.begin() + begin, vs.begin() + end, value_slots.begin() + t * segment_size);
+		counts[t] = end - begin;
+		if (end > begin)
+			heads[t] = key_slots[t * segment_size];
+	}
+	collection_size = n;
+}
+
+template <typename K, typename V>
+bool PackedArrayCollection<K,V>::find(const K& key, V& val) const {
+	COLLECTION_OP("PackedArray", OP_FIND);
+	int s = 0;
+	int i = 0;
+	lower_bound(key, s, i);
+	if (i == counts[s] || !(key_slots[s * segment_size + i] == key))
+		return false;
+	val = value_slots[s * segment_size + i];
+	return true;
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::find(const K& k1, const K& k2, std::vector <K>& ks) const {
+	COLLECTION_OP("PackedArray", OP_RANGE);
+	ks.clear();
+	int s = 0;
+	int i = 0;
+	lower_bound(k1, s, i);
+	for (; s < (int) counts.size(); s++, i = 0)
+		for (; i < counts[s]; i++) {
+			const K& key = key_slots[s * segment_size + i];
+			if (key > k2)
+				return;
+			ks.push_back(key);
+		}
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::keys(std::vector <K>& ks) const {
+	ks.clear();
+	ks.reserve(collection_size);
+	for (int s = 0; s < (int) counts.size(); s++)
+		ks.insert(ks.end(), key_slots.begin() + s * segment_size, key_slots.begin() + s * segment_size + counts[s]);
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::sort(std::vector <K>& ks) const {
+	// the segments are in key order
+	keys(ks);
+}
+
+template <typename K, typename V>
+int PackedArrayCollection<K,V>::size() const {
+	return collection_size;
+}
+
+template <typename K, typename V>
+int PackedArrayCollection<K,V>::capacity() const {
+	return key_slots.size();
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	for (int s = 0; s < (int) counts.size(); s++)
+		for (int i = 0; i < counts[s]; i++)
+			if (!visitor(key_slots[s * segment_size + i], value_slots[s * segment_size + i]))
+				return;
+}
+
+template <typename K, typename V>
+void PackedArrayCollection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	int s = 0;
+	int i = 0;
+	lower_bound(k1, s, i);
+	for (; s < (int) counts.size(); s++, i = 0)
+		for (; i < counts[s]; i++) {
+			const K& key = key_slots[s * segment_size + i];
+			if (key > k2 || !visitor(key, value_slots[s * segment_size + i]))
+				return;
+		}
+}
+
+template <typename K, typename V>
+template <typename Iter>
+void PackedArrayCollection<K,V>::bulk_load(Iter begin, Iter end) {
+	std::vector<K> ks;
+	std::vector<V> vs;
+	if (!keys_ascending(begin, end)) {
+		std::vector<std::pair<K,V>> sorted;
+		sort_by_key(begin, end, sorted);
+		ks.reserve(sorted.size());
+		vs.reserve(sorted.size());
+		for (std::pair<K,V>& p : sorted) {
+			ks.push_back(std::move(p.first));
+			vs.push_back(std::move(p.second));
+		}
+	}
+	else {
+		// already in order, so lay them out in one pass
+		ks.reserve(std::distance(begin, end));
+		vs.reserve(std::distance(begin, end));
+		for (Iter it = begin; it != end; ++it) {
+			ks.push_back(it->first);
+			vs.push_back(it->second);
+		}
+	}
+	rebuild(ks, vs);
+}
+
+#endif
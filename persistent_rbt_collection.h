@@ -0,0 +1,600 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Implementation of Collection using a persistent (left-leaning)
+red black tree that readers can share with a writer. Nodes are never
+changed once published: an insert or remove copies the nodes it touches,
+from the one it changes up to the root, and shares every other subtree with
+the previous version. It then publishes the new root with one atomic store.
+Readers never lock and never see a half finished change.
+
+snapshot() takes the current version in O(1) time. The view stays as it was
+however long it is used, so a long range scan does not copy the tree or
+hold up the writers. The nodes a write replaces are retired through
+epoch.h and freed once no reader or snapshot can still reach them.
+
+Writes are serialized by a mutex; reads, including snapshots, can run on
+any number of threads alongside them. Unlike RBTCollection, inserting a key
+that is already present replaces its value.
+*/
+
+#ifndef PERSISTENT_RBT_COLLECTION_H
+#define PERSISTENT_RBT_COLLECTION_H
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include "collection.h"
+#include "epoch.h"
+#include "tree_traversal.h"
+#include "instrumentation.h"
+
+
+template <typename K, typename V>
+class PersistentRBTCollection : public Collection<K,V> {
+private:
+	// tree node (nodes come from new, not a NodePool, since retired ones
+	// are freed on whichever thread collects them)
+	struct Node {
+		K key;
+		V value;
+		Node* left;
+		Node* right;
+		bool is_black;
+		// the write that created the node (nodes of the running write
+		// can still be changed in place)
+		unsigned long stamp;
+	};
+
+	// a published version: its tree and the number of keys in it
+	struct Version {
+		const Node* root;
+		int size;
+	};
+
+public:
+	// a read only view of the collection as it was when snapshot() was
+	// called (it holds off the freeing of retired nodes while it lives, so
+	// it must be released on the thread that took it, before the
+	// collection is deleted)
+	class Snapshot {
+	public:
+		// find the value associated with the key
+		bool find(const K& key, V& val) const;
+
+		// find the keys associated with the range
+		void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+		// return all keys in sorted order
+		void keys(std::vector<K>& keys) const;
+
+		// return the number of keys
+		int size() const;
+
+		// call visitor on each key-value pair with k1 <= key <= k2 in
+		// ascending key order until it returns false
+		void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	private:
+		friend class PersistentRBTCollection<K,V>;
+
+		Snapshot(const std::atomic<Version*>& current);
+
+		// entered before the version is loaded
+		EpochGuard guard;
+		const Version* version;
+	};
+
+	// create an empty tree
+	PersistentRBTCollection();
+
+	// copy a tree (rhs may be in use by other threads, this object may
+	// not)
+	PersistentRBTCollection(const PersistentRBTCollection<K,V>& rhs);
+
+	// assign a tree (rhs may be in use by other threads, this object may
+	// not)
+	PersistentRBTCollection<K,V>& operator =(const PersistentRBTCollection<K,V>& rhs);
+
+	// delete a tree
+	~PersistentRBTCollection();
+
+	// insert a key-value pair into the collection (replaces the value if
+	// the key is already present)
+	void insert(const K& key, const V& val);
+
+	// remove a key-value pair from the collection
+	void remove(const K& key);
+
+	// find the value associated with the key
+	bool find(const K& key, V& val) const;
+
+	// find the keys associated with the range
+	void find(const K& k1, const K& k2, std::vector<K>& keys) const;
+
+	// return all keys in the collection
+	void keys(std::vector<K>& keys) const;
+
+	// return collection keys in sorted order
+	void sort(std::vector<K>& keys) const;
+
+	// return the number of keys in collection
+	int size() const;
+
+	// call visitor on each key-value pair in ascending key order until it
+	// returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2 in ascending
+	// key order until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// return a consistent read only view of the current version, in O(1)
+	// time
+	Snapshot snapshot() const;
+
+	// return the height of the tree
+	int height() const;
+
+private:
+	// find key in the tree at root
+	static bool find(const Node* root, const K& key, V& val);
+
+	// append the keys of the tree at root in the range (all of them if k1
+	// and k2 are not set) to keys, in ascending order
+	static void append_keys(const Node* root, const K* k1, const K* k2, std::vector<K>& keys);
+
+	// return whether node is red (empty subtrees are black)
+	static bool is_red(const Node* node) { return node && !node->is_black; }
+
+	// return node if this write created it, else a copy of it that this
+	// write may change (the original is retired once the write is
+	// published)
+	Node* own(const Node* node);
+
+	// a new red node created by this write
+	Node* new_node(const K& key, const V& val);
+
+	// take a node this write created out of the write (freed once the
+	// write is published, since it never is)
+	void drop(Node* node) { dropped.push_back(node); }
+
+	// rotate the red right (left) child of node up, and return it; node
+	// must be owned
+	Node* rotate_left(Node* node);
+	Node* rotate_right(Node* node);
+
+	// flip the colors of node and its children; node must be owned
+	void flip_colors(Node* node);
+
+	// push a red link down the left (right) side on the way to a removal
+	Node* move_red_left(Node* node);
+	Node* move_red_right(Node* node);
+
+	// restore the left-leaning invariants on the way back up
+	Node* balance(Node* node);
+
+	// insert into or remove from the subtree at node (which is not empty
+	// and holds key, for the removes), and return the new subtree
+	Node* insert(const Node* node, const K& key, const V& val);
+	Node* remove(const Node* node, const K& key);
+	Node* remove_min(const Node* node);
+
+	// publish a new tree of size keys and retire what the write replaced
+	// (the writer lock must be held)
+	void publish(const Node* root, int size);
+
+	// give up the running write: free the nodes it created and keep the
+	// ones it would have replaced (nothing to do after publish())
+	void abandon();
+
+	// abandons the running write when it goes out of scope, so a write
+	// that throws (a K or V copy, or an allocation) leaves the tree as it
+	// was
+	struct WriteScope {
+		PersistentRBTCollection<K,V>& tree;
+		~WriteScope() { tree.abandon(); }
+	};
+
+	// free every node of the tree at root at once (no reader may be using
+	// it)
+	static void destroy(const Node* root);
+
+	// copy the current version of rhs into this (empty) object
+	void copy_from(const PersistentRBTCollection<K,V>& rhs);
+
+	// the current version
+	std::atomic<Version*> current;
+
+	// writers take turns
+	std::mutex writer_lock;
+
+	// the stamp of the running write (the last write's, between writes)
+	unsigned long write_stamp;
+
+	// set by insert() when the key was not present yet
+	bool added;
+
+	// the published nodes the running write replaced
+	std::vector<const Node*> replaced;
+
+	// the nodes the running write created, and those of them it dropped
+	std::vector<Node*> created;
+	std::vector<Node*> dropped;
+};
+
+
+template <typename K, typename V>
+PersistentRBTCollection<K,V>::Snapshot::Snapshot(const std::atomic<Version*>& current):
+	version(current.load(std::memory_order_acquire)) {}
+
+template <typename K, typename V>
+bool PersistentRBTCollection<K,V>::Snapshot::find(const K& key, V& val) const {
+	return PersistentRBTCollection<K,V>::find(version->root, key, val);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::Snapshot::find(const K& k1, const K& k2, std::vector<K>& ks) const {
+	ks.clear();
+	append_keys(version->root, &k1, &k2, ks);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::Snapshot::keys(std::vector<K>& ks) const {
+	ks.clear();
+	append_keys(version->root, (const K*) nullptr, (const K*) nullptr, ks);
+}
+
+template <typename K, typename V>
+int PersistentRBTCollection<K,V>::Snapshot::size() const {
+	return version->size;
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::Snapshot::visit(const K& k1, const K& k2,
+	const std::function<bool(const K&, const V&)>& visitor) const {
+	inorder_nodes(version->root, &k1, &k2, [&visitor](const Node* ptr) {
+		return visitor(ptr->key, ptr->value);
+	});
+}
+
+
+template <typename K, typename V>
+PersistentRBTCollection<K,V>::PersistentRBTCollection(): current(new Version{nullptr, 0}), write_stamp(0),
+	added(false) {}
+
+template <typename K, typename V>
+PersistentRBTCollection<K,V>::PersistentRBTCollection(const PersistentRBTCollection<K,V>& rhs):
+	current(nullptr), write_stamp(0), added(false) {
+	copy_from(rhs);
+}
+
+template <typename K, typename V>
+PersistentRBTCollection<K,V>& PersistentRBTCollection<K,V>::operator=(const PersistentRBTCollection<K,V>& rhs) {
+	// check if rhs is current object and return current object
+	if (this == &rhs)
+		return *this;
+	Version* old = current.load();
+	destroy(old->root);
+	delete old;
+	copy_from(rhs);
+	return *this;
+}
+
+template <typename K, typename V>
+PersistentRBTCollection<K,V>::~PersistentRBTCollection() {
+	Version* old = current.load();
+	destroy(old->root);
+	delete old;
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::copy_from(const PersistentRBTCollection<K,V>& rhs) {
+	EpochGuard guard;
+	const Version* version = rhs.current.load(std::memory_order_acquire);
+	Node* root = clone_nodes(version->root, []() { return new Node; });
+	// stamp 0 is older than any write to this object
+	preorder_nodes(root, [](const Node* ptr) { const_cast<Node*>(ptr)->stamp = 0; });
+	current.store(new Version{root, version->size});
+	write_stamp = 0;
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::destroy(const Node* root) {
+	destroy_nodes(const_cast<Node*>(root), [](Node* ptr) { delete ptr; });
+}
+
+template <typename K, typename V>
+bool PersistentRBTCollection<K,V>::find(const Node* root, const K& key, V& val) {
+	const Node* curr = root;
+	while (curr) {
+		COLLECTION_PROBES(1);
+		if (key == curr->key) {
+			val = curr->value;
+			return true;
+		}
+		curr = key < curr->key ? curr->left : curr->right;
+	}
+	return false;
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::append_keys(const Node* root, const K* k1, const K* k2, std::vector<K>& ks) {
+	inorder_nodes(root, k1, k2, [&ks](const Node* ptr) {
+		ks.push_back(ptr->key);
+		return true;
+	});
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::own(const Node* node) {
+	if (node->stamp == write_stamp)
+		return const_cast<Node*>(node);
+	// listed before it exists, so a throw cannot leave it unlisted
+	created.push_back(nullptr);
+	Node* copy = new Node(*node);
+	created.back() = copy;
+	copy->stamp = write_stamp;
+	replaced.push_back(node);
+	return copy;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::new_node(const K& key, const V& val) {
+	created.push_back(nullptr);
+	Node* ptr = new Node{key, val, nullptr, nullptr, false, write_stamp};
+	created.back() = ptr;
+	return ptr;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::rotate_left(Node* node) {
+	Node* x = own(node->right);
+	node->right = x->left;
+	x->left = node;
+	x->is_black = node->is_black;
+	node->is_black = false;
+	return x;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::rotate_right(Node* node) {
+	Node* x = own(node->left);
+	node->left = x->right;
+	x->right = node;
+	x->is_black = node->is_black;
+	node->is_black = false;
+	return x;
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::flip_colors(Node* node) {
+	Node* left = own(node->left);
+	Node* right = own(node->right);
+	node->is_black = !node->is_black;
+	left->is_black = !left->is_black;
+	right->is_black = !right->is_black;
+	node->left = left;
+	node->right = right;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::move_red_left(Node* node) {
+	flip_colors(node);
+	if (is_red(node->right->left)) {
+		node->right = rotate_right(node->right);
+		node = rotate_left(node);
+		flip_colors(node);
+	}
+	return node;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::move_red_right(Node* node) {
+	flip_colors(node);
+	if (is_red(node->left->left)) {
+		node = rotate_right(node);
+		flip_colors(node);
+	}
+	return node;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::balance(Node* node) {
+	if (is_red(node->right) && !is_red(node->left))
+		node = rotate_left(node);
+	if (is_red(node->left) && is_red(node->left->left))
+		node = rotate_right(node);
+	if (is_red(node->left) && is_red(node->right))
+		flip_colors(node);
+	return node;
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::insert(const Node* node, const K& key,
+	const V& val) {
+	if (!node) {
+		added = true;
+		return new_node(key, val);
+	}
+	COLLECTION_PROBES(1);
+	Node* ptr = own(node);
+	if (key < ptr->key)
+		ptr->left = insert(ptr->left, key, val);
+	else if (key == ptr->key)
+		ptr->value = val;
+	else
+		ptr->right = insert(ptr->right, key, val);
+	return balance(ptr);
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::remove_min(const Node* node) {
+	Node* ptr = own(node);
+	if (!ptr->left) {
+		drop(ptr);
+		return nullptr;
+	}
+	if (!is_red(ptr->left) && !is_red(ptr->left->left))
+		ptr = move_red_left(ptr);
+	ptr->left = remove_min(ptr->left);
+	return balance(ptr);
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Node* PersistentRBTCollection<K,V>::remove(const Node* node, const K& key) {
+	COLLECTION_PROBES(1);
+	Node* ptr = own(node);
+	if (key < ptr->key) {
+		if (!is_red(ptr->left) && !is_red(ptr->left->left))
+			ptr = move_red_left(ptr);
+		ptr->left = remove(ptr->left, key);
+	}
+	else {
+		if (is_red(ptr->left))
+			ptr = rotate_right(ptr);
+		// a node with no right child has no left child either
+		if (key == ptr->key && !ptr->right) {
+			drop(ptr);
+			return nullptr;
+		}
+		if (!is_red(ptr->right) && !is_red(ptr->right->left))
+			ptr = move_red_right(ptr);
+		if (key == ptr->key) {
+			// take the place of the next key, then remove that
+			const Node* next = ptr->right;
+			while (next->left)
+				next = next->left;
+			ptr->key = next->key;
+			ptr->value = next->value;
+			ptr->right = remove_min(ptr->right);
+		}
+		else
+			ptr->right = remove(ptr->right, key);
+	}
+	return balance(ptr);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::publish(const Node* root, int size) {
+	Version* version = new Version{root, size};
+	Version* old = current.load();
+	current.store(version, std::memory_order_release);
+	// the created nodes belong to the tree now, except the dropped ones
+	created.clear();
+	for (Node* ptr : dropped)
+		delete ptr;
+	dropped.clear();
+	// readers that loaded the old version are inside their guards, so
+	// nothing it alone reaches is freed before they are done
+	std::vector<const Node*> retired;
+	retired.swap(replaced);
+	for (const Node* ptr : retired)
+		epoch_retire(const_cast<Node*>(ptr));
+	epoch_retire(old);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::abandon() {
+	// the dropped nodes are among the created ones
+	for (Node* ptr : created)
+		delete ptr;
+	created.clear();
+	dropped.clear();
+	replaced.clear();
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::insert(const K& key, const V& val) {
+	COLLECTION_OP("PersistentRBT", OP_INSERT);
+	std::lock_guard<std::mutex> lock(writer_lock);
+	WriteScope scope{*this};
+	const Version* version = current.load();
+	write_stamp++;
+	added = false;
+	Node* root = insert(version->root, key, val);
+	root->is_black = true;
+	publish(root, version->size + added);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::remove(const K& key) {
+	COLLECTION_OP("PersistentRBT", OP_REMOVE);
+	std::lock_guard<std::mutex> lock(writer_lock);
+	const Version* version = current.load();
+	V val;
+	if (!find(version->root, key, val))
+		return;
+	WriteScope scope{*this};
+	write_stamp++;
+	Node* root = own(version->root);
+	if (!is_red(root->left) && !is_red(root->right))
+		root->is_black = false;
+	root = remove(root, key);
+	if (root)
+		root->is_black = true;
+	publish(root, version->size - 1);
+}
+
+template <typename K, typename V>
+bool PersistentRBTCollection<K,V>::find(const K& key, V& val) const {
+	COLLECTION_OP("PersistentRBT", OP_FIND);
+	EpochGuard guard;
+	return find(current.load(std::memory_order_acquire)->root, key, val);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& ks) const {
+	COLLECTION_OP("PersistentRBT", OP_RANGE);
+	ks.clear();
+	EpochGuard guard;
+	append_keys(current.load(std::memory_order_acquire)->root, &k1, &k2, ks);
+	COLLECTION_PROBES(ks.size());
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::keys(std::vector<K>& ks) const {
+	ks.clear();
+	EpochGuard guard;
+	append_keys(current.load(std::memory_order_acquire)->root, (const K*) nullptr, (const K*) nullptr, ks);
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::sort(std::vector<K>& ks) const {
+	// the in-order walk is already sorted
+	keys(ks);
+}
+
+template <typename K, typename V>
+int PersistentRBTCollection<K,V>::size() const {
+	EpochGuard guard;
+	return current.load(std::memory_order_acquire)->size;
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::visit(const std::function<bool(const K&, const V&)>& visitor) const {
+	EpochGuard guard;
+	inorder_nodes(current.load(std::memory_order_acquire)->root, (const K*) nullptr, (const K*) nullptr,
+		[&visitor](const Node* ptr) {
+			return visitor(ptr->key, ptr->value);
+		});
+}
+
+template <typename K, typename V>
+void PersistentRBTCollection<K,V>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const {
+	snapshot().visit(k1, k2, visitor);
+}
+
+template <typename K, typename V>
+typename PersistentRBTCollection<K,V>::Snapshot PersistentRBTCollection<K,V>::snapshot() const {
+	return Snapshot(current);
+}
+
+template <typename K, typename V>
+int PersistentRBTCollection<K,V>::height() const {
+	EpochGuard guard;
+	return tree_height(current.load(std::memory_order_acquire)->root);
+}
+
+#endif
@@ -0,0 +1,263 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Search kernels over a contiguous array of keys, used by the
+collections that keep their keys apart from the values (see kv_storage.h).
+scan_equal() is a linear search (for one key, or the first of two) and
+search_lower_bound() a binary search without branches on the key
+comparisons, finishing with a linear count once the range fits in a
+couple of cache lines. For 4 and 8 byte integer
+and floating point keys both compare a vector register of keys at a time
+with AVX2 (when built with -mavx2 or -march=native) or SSE2; other key
+types use the scalar loops.
+*/
+
+#ifndef SEARCH_KERNELS_H
+#define SEARCH_KERNELS_H
+
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+// binary search stops and counts linearly once this many keys are left
+const int linear_search_max = 16;
+
+
+// return the index of the first keys[i] == a or keys[i] == b in keys[0..n),
+// or -1 (each vector branch skips ahead four registers of keys at a time
+// until one of them matches, then finds the first match a register at a time)
+template <typename K>
+int scan_equal(const K* keys, int n, const K& a, const K& b) {
+	int i = 0;
+#if defined(__AVX2__)
+	if constexpr (std::is_integral<K>::value && sizeof(K) == 8) {
+		__m256i ka = _mm256_set1_epi64x(static_cast<long long>(a));
+		__m256i kb = _mm256_set1_epi64x(static_cast<long long>(b));
+		auto eq = [&](int j) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + j));
+			return _mm256_or_si256(_mm256_cmpeq_epi64(x, ka), _mm256_cmpeq_epi64(x, kb));
+		};
+		for (; i + 16 <= n; i += 16)
+			if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(eq(i), eq(i + 4)), _mm256_or_si256(eq(i + 8), eq(i + 12))),
+			                        _mm256_set1_epi8(-1)))
+				break;
+		for (; i + 4 <= n; i += 4) {
+			int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq(i)));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+	else if constexpr (std::is_integral<K>::value && sizeof(K) == 4) {
+		__m256i ka = _mm256_set1_epi32(static_cast<int>(a));
+		__m256i kb = _mm256_set1_epi32(static_cast<int>(b));
+		auto eq = [&](int j) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + j));
+			return _mm256_or_si256(_mm256_cmpeq_epi32(x, ka), _mm256_cmpeq_epi32(x, kb));
+		};
+		for (; i + 32 <= n; i += 32)
+			if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(eq(i), eq(i + 8)), _mm256_or_si256(eq(i + 16), eq(i + 24))),
+			                        _mm256_set1_epi8(-1)))
+				break;
+		for (; i + 8 <= n; i += 8) {
+			int mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq(i)));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+	else if constexpr (std::is_same<K, double>::value) {
+		__m256d ka = _mm256_set1_pd(a);
+		__m256d kb = _mm256_set1_pd(b);
+		auto eq = [&](int j) {
+			__m256d x = _mm256_loadu_pd(keys + j);
+			return _mm256_or_pd(_mm256_cmp_pd(x, ka, _CMP_EQ_OQ), _mm256_cmp_pd(x, kb, _CMP_EQ_OQ));
+		};
+		for (; i + 16 <= n; i += 16)
+			if (_mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(eq(i), eq(i + 4)), _mm256_or_pd(eq(i + 8), eq(i + 12)))))
+				break;
+		for (; i + 4 <= n; i += 4) {
+			int mask = _mm256_movemask_pd(eq(i));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+	else if constexpr (std::is_same<K, float>::value) {
+		__m256 ka = _mm256_set1_ps(a);
+		__m256 kb = _mm256_set1_ps(b);
+		auto eq = [&](int j) {
+			__m256 x = _mm256_loadu_ps(keys + j);
+			return _mm256_or_ps(_mm256_cmp_ps(x, ka, _CMP_EQ_OQ), _mm256_cmp_ps(x, kb, _CMP_EQ_OQ));
+		};
+		for (; i + 32 <= n; i += 32)
+			if (_mm256_movemask_ps(_mm256_or_ps(_mm256_or_ps(eq(i), eq(i + 8)), _mm256_or_ps(eq(i + 16), eq(i + 24)))))
+				break;
+		for (; i + 8 <= n; i += 8) {
+			int mask = _mm256_movemask_ps(eq(i));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(__SSE2__)
+	if constexpr (std::is_integral<K>::value && sizeof(K) == 8) {
+		__m128i ka = _mm_set1_epi64x(static_cast<long long>(a));
+		__m128i kb = _mm_set1_epi64x(static_cast<long long>(b));
+		// SSE2 has no 64 bit compare, so both 32 bit halves of a lane have
+		// to match
+		auto eq = [&](int j) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + j));
+			__m128i eqa = _mm_cmpeq_epi32(x, ka);
+			__m128i eqb = _mm_cmpeq_epi32(x, kb);
+			eqa = _mm_and_si128(eqa, _mm_shuffle_epi32(eqa, _MM_SHUFFLE(2, 3, 0, 1)));
+			eqb = _mm_and_si128(eqb, _mm_shuffle_epi32(eqb, _MM_SHUFFLE(2, 3, 0, 1)));
+			return _mm_or_si128(eqa, eqb);
+		};
+		for (; i + 8 <= n; i += 8)
+			if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(eq(i), eq(i + 2)), _mm_or_si128(eq(i + 4), eq(i + 6)))))
+				break;
+		for (; i + 2 <= n; i += 2) {
+			int mask = _mm_movemask_pd(_mm_castsi128_pd(eq(i)));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+	else if constexpr (std::is_integral<K>::value && sizeof(K) == 4) {
+		__m128i ka = _mm_set1_epi32(static_cast<int>(a));
+		__m128i kb = _mm_set1_epi32(static_cast<int>(b));
+		auto eq = [&](int j) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + j));
+			return _mm_or_si128(_mm_cmpeq_epi32(x, ka), _mm_cmpeq_epi32(x, kb));
+		};
+		for (; i + 16 <= n; i += 16)
+			if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(eq(i), eq(i + 4)), _mm_or_si128(eq(i + 8), eq(i + 12)))))
+				break;
+		for (; i + 4 <= n; i += 4) {
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(eq(i)));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+	else if constexpr (std::is_same<K, double>::value) {
+		__m128d ka = _mm_set1_pd(a);
+		__m128d kb = _mm_set1_pd(b);
+		auto eq = [&](int j) {
+			__m128d x = _mm_loadu_pd(keys + j);
+			return _mm_or_pd(_mm_cmpeq_pd(x, ka), _mm_cmpeq_pd(x, kb));
+		};
+		for (; i + 8 <= n; i += 8)
+			if (_mm_movemask_pd(_mm_or_pd(_mm_or_pd(eq(i), eq(i + 2)), _mm_or_pd(eq(i + 4), eq(i + 6)))))
+				break;
+		for (; i + 2 <= n; i += 2) {
+			int mask = _mm_movemask_pd(eq(i));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+	else if constexpr (std::is_same<K, float>::value) {
+		__m128 ka = _mm_set1_ps(a);
+		__m128 kb = _mm_set1_ps(b);
+		auto eq = [&](int j) {
+			__m128 x = _mm_loadu_ps(keys + j);
+			return _mm_or_ps(_mm_cmpeq_ps(x, ka), _mm_cmpeq_ps(x, kb));
+		};
+		for (; i + 16 <= n; i += 16)
+			if (_mm_movemask_ps(_mm_or_ps(_mm_or_ps(eq(i), eq(i + 4)), _mm_or_ps(eq(i + 8), eq(i + 12)))))
+				break;
+		for (; i + 4 <= n; i += 4) {
+			int mask = _mm_movemask_ps(eq(i));
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+	// the keys left over (or all of them for other key types)
+	for (; i < n; i++)
+		if (keys[i] == a || keys[i] == b)
+			return i;
+	return -1;
+}
+
+
+// return the index of the first keys[i] == key in keys[0..n), or -1
+template <typename K>
+int scan_equal(const K* keys, int n, const K& key) {
+	return scan_equal(keys, n, key, key);
+}
+
+
+// return the number of keys[i] < key in keys[0..n)
+template <typename K>
+int count_less(const K* keys, int n, const K& key) {
+	int i = 0;
+	int count = 0;
+#if defined(__AVX2__)
+	if constexpr (std::is_integral<K>::value && std::is_signed<K>::value && sizeof(K) == 8) {
+		__m256i k = _mm256_set1_epi64x(static_cast<long long>(key));
+		for (; i + 4 <= n; i += 4) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+			count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, x))));
+		}
+	}
+	else if constexpr (std::is_integral<K>::value && std::is_signed<K>::value && sizeof(K) == 4) {
+		__m256i k = _mm256_set1_epi32(static_cast<int>(key));
+		for (; i + 8 <= n; i += 8) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+			count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, x))));
+		}
+	}
+	else if constexpr (std::is_same<K, double>::value) {
+		__m256d k = _mm256_set1_pd(key);
+		for (; i + 4 <= n; i += 4)
+			count += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(keys + i), k, _CMP_LT_OQ)));
+	}
+	else if constexpr (std::is_same<K, float>::value) {
+		__m256 k = _mm256_set1_ps(key);
+		for (; i + 8 <= n; i += 8)
+			count += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(keys + i), k, _CMP_LT_OQ)));
+	}
+#elif defined(__SSE2__)
+	// (SSE2 has no 64 bit integer compare, so those stay scalar)
+	if constexpr (std::is_integral<K>::value && std::is_signed<K>::value && sizeof(K) == 4) {
+		__m128i k = _mm_set1_epi32(static_cast<int>(key));
+		for (; i + 4 <= n; i += 4) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+			count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, x))));
+		}
+	}
+	else if constexpr (std::is_same<K, double>::value) {
+		__m128d k = _mm_set1_pd(key);
+		for (; i + 2 <= n; i += 2)
+			count += __builtin_popcount(_mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(keys + i), k)));
+	}
+	else if constexpr (std::is_same<K, float>::value) {
+		__m128 k = _mm_set1_ps(key);
+		for (; i + 4 <= n; i += 4)
+			count += __builtin_popcount(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys + i), k)));
+	}
+#endif
+	for (; i < n; i++)
+		count += keys[i] < key;
+	return count;
+}
+
+
+// return the index of the first keys[i] >= key in the ascending keys[0..n)
+// (n if there is none)
+template <typename K>
+int search_lower_bound(const K* keys, int n, const K& key) {
+	// the answer is always in base[0..n]; each step halves n with a
+	// conditional move instead of a branch the CPU would mispredict half
+	// the time, and prefetches both places the next step could look
+	const K* base = keys;
+	while (n > linear_search_max) {
+		int half = n / 2;
+		__builtin_prefetch(base + half / 2);
+		__builtin_prefetch(base + half + half / 2);
+		base = base[half - 1] < key ? base + half : base;
+		n -= half;
+	}
+	return (base - keys) + count_less(base, n, key);
+}
+
+#endif
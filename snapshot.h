@@ -0,0 +1,302 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Binary snapshot files of a collection, for trivially copyable
+keys and values. save_snapshot() writes the pairs in ascending key order as
+two arrays, the keys then the values, each starting on a 64 byte boundary
+after a fixed header (magic, format version, byte order, key and value
+sizes and kinds, count and array offsets). load_snapshot() fills any
+collection from a snapshot (through bulk_load() when the collection has
+one, so the ordered collections build in one pass), and SnapshotFile maps
+a snapshot read only so MappedCollection can search the key array in place
+without reading the pairs in first.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <string>
+#include <type_traits>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "collection.h"
+
+
+// format version written to new snapshots (files of any other version
+// are rejected)
+const uint32_t snapshot_version = 1;
+
+
+// fixed header at the start of a snapshot file
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	// snapshot_byte_order as written (reads back swapped on a machine of
+	// the other byte order)
+	uint32_t byte_order;
+	uint32_t key_size;
+	uint32_t value_size;
+	uint32_t key_kind;
+	uint32_t value_kind;
+	uint64_t count;
+	uint64_t keys_offset;
+	uint64_t values_offset;
+	char reserved[8];
+};
+
+const char snapshot_magic[8] = {'C', 'O', 'L', 'L', 'S', 'N', 'A', 'P'};
+const uint32_t snapshot_byte_order = 0x01020304;
+
+// arrays in a snapshot start on multiples of this
+const uint64_t snapshot_align = 64;
+
+
+// kind of a key or value type recorded in the header (0 other, 1 signed
+// integer, 2 unsigned integer, 3 floating point), so a snapshot is not read
+// as another type of the same size
+template <typename T>
+uint32_t snapshot_kind() {
+	if (std::is_floating_point<T>::value)
+		return 3;
+	if (std::is_integral<T>::value)
+		return std::is_signed<T>::value ? 1 : 2;
+	return 0;
+}
+
+
+// fill header for count pairs of K and V
+template <typename K, typename V>
+void make_snapshot_header(uint64_t count, SnapshotHeader& header) {
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+	header.version = snapshot_version;
+	header.byte_order = snapshot_byte_order;
+	header.key_size = sizeof(K);
+	header.value_size = sizeof(V);
+	header.key_kind = snapshot_kind<K>();
+	header.value_kind = snapshot_kind<V>();
+	header.count = count;
+	header.keys_offset = (sizeof(SnapshotHeader) + snapshot_align - 1) / snapshot_align * snapshot_align;
+	header.values_offset = (header.keys_offset + count * sizeof(K) + snapshot_align - 1) / snapshot_align * snapshot_align;
+}
+
+
+// write the pairs of c to the file at path in ascending key order and
+// return true on success (the file is written under a temporary name and
+// renamed over path, so a failed save leaves any old snapshot in place)
+template <typename K, typename V>
+bool save_snapshot(const Collection<K,V>& c, const char* path) {
+	static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+		"snapshots hold trivially copyable keys and values");
+	std::vector<std::pair<K,V>> pairs;
+	pairs.reserve(c.size());
+	c.visit([&pairs](const K& key, const V& val) {
+		pairs.emplace_back(key, val);
+		return true;
+	});
+	// the ordered collections visit in order already
+	if (!std::is_sorted(pairs.begin(), pairs.end(),
+		[](const std::pair<K,V>& a, const std::pair<K,V>& b) { return a.first < b.first; }))
+		std::stable_sort(pairs.begin(), pairs.end(),
+			[](const std::pair<K,V>& a, const std::pair<K,V>& b) { return a.first < b.first; });
+
+	SnapshotHeader header;
+	make_snapshot_header<K,V>(pairs.size(), header);
+	std::vector<K> ks(pairs.size());
+	std::vector<V> vals(pairs.size());
+	for (size_t i = 0; i < pairs.size(); i++) {
+		ks[i] = pairs[i].first;
+		vals[i] = pairs[i].second;
+	}
+
+	std::string temp_path = std::string(path) + ".tmp";
+	std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+	if (!file)
+		return false;
+	static const char padding[snapshot_align] = {};
+	uint64_t keys_end = header.keys_offset + ks.size() * sizeof(K);
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(padding, 1, header.keys_offset - sizeof(header), file) == header.keys_offset - sizeof(header) &&
+		(ks.empty() || std::fwrite(ks.data(), sizeof(K), ks.size(), file) == ks.size()) &&
+		std::fwrite(padding, 1, header.values_offset - keys_end, file) == header.values_offset - keys_end &&
+		(vals.empty() || std::fwrite(vals.data(), sizeof(V), vals.size(), file) == vals.size());
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok || std::rename(temp_path.c_str(), path) != 0) {
+		std::remove(temp_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+// a snapshot file mapped read only
+template <typename K, typename V>
+class SnapshotFile {
+public:
+
+	// create an unmapped file
+	SnapshotFile();
+
+	// unmap the file
+	~SnapshotFile();
+
+	// a mapping is not copied
+	SnapshotFile(const SnapshotFile<K,V>& rhs) = delete;
+	SnapshotFile<K,V>& operator =(const SnapshotFile<K,V>& rhs) = delete;
+
+	// map the snapshot at path and return true if it is a snapshot of this
+	// format version and of K and V whose arrays fit in the file (the keys
+	// are trusted to be ascending, checking would read the whole file)
+	bool open(const char* path);
+
+	// unmap the file
+	void close();
+
+	// true while a file is mapped
+	bool is_open() const;
+
+	// number of pairs
+	int size() const;
+
+	// ascending keys and their values, in the mapping
+	const K* keys() const;
+	const V* values() const;
+
+private:
+	void* data;
+	size_t length;
+	bool mapped;
+};
+
+
+template <typename K, typename V>
+SnapshotFile<K,V>::SnapshotFile(): data(nullptr), length(0), mapped(false) {}
+
+template <typename K, typename V>
+SnapshotFile<K,V>::~SnapshotFile() {
+	close();
+}
+
+template <typename K, typename V>
+bool SnapshotFile<K,V>::open(const char* path) {
+	static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+		"snapshots hold trivially copyable keys and values");
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(SnapshotHeader)) {
+		::close(fd);
+		return false;
+	}
+	length = info.st_size;
+	data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	// the mapping stays valid once the descriptor is closed
+	::close(fd);
+	if (data == MAP_FAILED) {
+		data = nullptr;
+		return false;
+	}
+	mapped = true;
+
+	SnapshotHeader expected;
+	const SnapshotHeader* header = static_cast<const SnapshotHeader*>(data);
+	make_snapshot_header<K,V>(header->count, expected);
+	bool ok = std::memcmp(header->magic, expected.magic, sizeof(header->magic)) == 0 &&
+		header->version == expected.version &&
+		header->byte_order == expected.byte_order &&
+		header->key_size == expected.key_size &&
+		header->value_size == expected.value_size &&
+		header->key_kind == expected.key_kind &&
+		header->value_kind == expected.value_kind &&
+		header->count <= 0x7fffffff &&
+		header->keys_offset == expected.keys_offset &&
+		header->values_offset == expected.values_offset &&
+		header->values_offset + header->count * sizeof(V) <= length;
+	if (!ok)
+		close();
+	return ok;
+}
+
+template <typename K, typename V>
+void SnapshotFile<K,V>::close() {
+	if (!mapped)
+		return;
+	munmap(data, length);
+	data = nullptr;
+	length = 0;
+	mapped = false;
+}
+
+template <typename K, typename V>
+bool SnapshotFile<K,V>::is_open() const {
+	return mapped;
+}
+
+template <typename K, typename V>
+int SnapshotFile<K,V>::size() const {
+	return mapped ? static_cast<const SnapshotHeader*>(data)->count : 0;
+}
+
+template <typename K, typename V>
+const K* SnapshotFile<K,V>::keys() const {
+	return reinterpret_cast<const K*>(static_cast<const char*>(data) + static_cast<const SnapshotHeader*>(data)->keys_offset);
+}
+
+template <typename K, typename V>
+const V* SnapshotFile<K,V>::values() const {
+	return reinterpret_cast<const V*>(static_cast<const char*>(data) + static_cast<const SnapshotHeader*>(data)->values_offset);
+}
+
+
+// the pair type of a collection (only used in decltype, to find the key
+// and value types of a collection derived from Collection<K,V>)
+template <typename K, typename V>
+std::pair<K,V> collection_pair_type(const Collection<K,V>& c);
+
+
+// replace the contents of c with pairs (through bulk_load() if C has one)
+template <typename C, typename K, typename V>
+auto fill_from_pairs(C& c, const std::vector<std::pair<K,V>>& pairs, int)
+	-> decltype(c.bulk_load(pairs.begin(), pairs.end()), void()) {
+	c.bulk_load(pairs.begin(), pairs.end());
+}
+
+template <typename C, typename K, typename V>
+void fill_from_pairs(C& c, const std::vector<std::pair<K,V>>& pairs, long) {
+	std::vector<K> old_keys;
+	c.keys(old_keys);
+	for (const K& key : old_keys)
+		c.remove(key);
+	for (const std::pair<K,V>& p : pairs)
+		c.insert(p.first, p.second);
+}
+
+
+// replace the contents of c with the snapshot at path and return true, or
+// return false (leaving c alone) if path is not a snapshot of c's key and
+// value types
+template <typename C>
+bool load_snapshot(C& c, const char* path) {
+	typedef typename decltype(collection_pair_type(c))::first_type K;
+	typedef typename decltype(collection_pair_type(c))::second_type V;
+	SnapshotFile<K,V> file;
+	if (!file.open(path))
+		return false;
+	std::vector<std::pair<K,V>> pairs(file.size());
+	for (int i = 0; i < file.size(); i++)
+		pairs[i] = std::make_pair(file.keys()[i], file.values()[i]);
+	fill_from_pairs(c, pairs, 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,331 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Work-stealing thread pool used by the parallel_sort(),
+parallel_keys() and parallel_find() functions of the collections. Each
+worker has its own task deque: it pushes and pops its own tasks at the back
+and, when it runs dry, steals the oldest task from the front of another
+worker's deque. A thread waiting on a TaskGroup runs queued tasks instead of
+blocking, so a pool with no workers at all still finishes every task on
+the waiting thread.
+
+Also here are the fork-join helpers built on the pool: parallel_for(),
+sort_in_parallel() (sort chunks, then merge them pairwise, splitting each
+merge into pieces) and concat_in_parallel(). Their results never depend on
+how the work was scheduled.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+
+// collections smaller than this do the work on the calling thread
+const int parallel_min_items = 1 << 15;
+
+
+class ThreadPool {
+public:
+
+	// create a pool with the given number of worker threads
+	explicit ThreadPool(int threads);
+
+	// finish the queued tasks and join the workers
+	~ThreadPool();
+
+	// the pool shared by the collections (one worker per hardware thread
+	// besides the caller)
+	static ThreadPool& shared();
+
+	// number of worker threads
+	int size() const;
+
+	// queue a task (on the current worker's own deque when called from a
+	// worker of this pool)
+	void submit(std::function<void()> task);
+
+	// run one queued task on the calling thread if there is one
+	bool run_one();
+
+private:
+
+	// a worker's task deque (each on its own cache line)
+	struct alignas(64) Queue {
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	// worker thread main loop
+	void work(int index);
+
+	// take a task: own deque first (newest), then steal (oldest) starting
+	// after the own deque; index is -1 for threads outside the pool
+	bool take(int index, std::function<void()>& task);
+
+	// one deque per worker plus one for tasks submitted from outside
+	std::vector<Queue> queues;
+	std::vector<std::thread> workers;
+
+	// tasks queued and not yet taken (idle workers sleep while it is 0)
+	std::atomic<int> queued;
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	bool stopping;
+
+	// index of the current thread's deque if it is one of our workers
+	static thread_local ThreadPool* current_pool;
+	static thread_local int current_index;
+};
+
+
+// a set of tasks that can be waited on together
+class TaskGroup {
+public:
+
+	// group tasks run on pool
+	explicit TaskGroup(ThreadPool& pool);
+
+	// wait for any tasks still running (dropping any exception they threw)
+	~TaskGroup();
+
+	// queue a task in the group
+	void run(std::function<void()> task);
+
+	// run queued tasks until every task in the group has finished, then
+	// rethrow the first exception a task threw, if any
+	void wait();
+
+private:
+	// run queued tasks until every task in the group has finished
+	void drain();
+
+	ThreadPool& pool;
+	std::atomic<int> pending;
+
+	// the first exception a task threw (the others are dropped)
+	std::mutex error_lock;
+	std::exception_ptr error;
+};
+
+
+inline thread_local ThreadPool* ThreadPool::current_pool = nullptr;
+inline thread_local int ThreadPool::current_index = -1;
+
+
+inline ThreadPool::ThreadPool(int threads): queues(threads + 1), queued(0), stopping(false) {
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread([this, i]() { work(i); }));
+}
+
+inline ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+inline ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool(std::max(1, static_cast<int>(std::thread::hardware_concurrency())) - 1);
+	return pool;
+}
+
+inline int ThreadPool::size() const {
+	return workers.size();
+}
+
+inline void ThreadPool::submit(std::function<void()> task) {
+	int index = current_pool == this ? current_index : workers.size();
+	{
+		std::lock_guard<std::mutex> guard(queues[index].lock);
+		queues[index].tasks.push_back(std::move(task));
+	}
+	queued++;
+	// taking the lock makes sure a worker about to sleep sees the task
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+	}
+	wake.notify_one();
+}
+
+inline bool ThreadPool::take(int index, std::function<void()>& task) {
+	if (queued.load() == 0)
+		return false;
+	int count = queues.size();
+	if (index >= 0) {
+		std::lock_guard<std::mutex> guard(queues[index].lock);
+		if (!queues[index].tasks.empty()) {
+			task = std::move(queues[index].tasks.back());
+			queues[index].tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+	for (int i = 1; i <= count; i++) {
+		Queue& victim = queues[(index + i + count) % count];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool ThreadPool::run_one() {
+	std::function<void()> task;
+	if (!take(current_pool == this ? current_index : -1, task))
+		return false;
+	task();
+	return true;
+}
+
+inline void ThreadPool::work(int index) {
+	current_pool = this;
+	current_index = index;
+	while (true) {
+		std::function<void()> task;
+		if (take(index, task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		wake.wait(guard, [this]() { return stopping || queued.load() > 0; });
+		if (stopping && queued.load() == 0)
+			return;
+	}
+}
+
+
+inline TaskGroup::TaskGroup(ThreadPool& pool): pool(pool), pending(0) {}
+
+inline TaskGroup::~TaskGroup() {
+	drain();
+}
+
+inline void TaskGroup::run(std::function<void()> task) {
+	pending++;
+	pool.submit([this, task]() {
+		// an exception must not escape into the worker, and the task must
+		// count as done either way
+		try {
+			task();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> guard(error_lock);
+			if (!error)
+				error = std::current_exception();
+		}
+		pending--;
+	});
+}
+
+inline void TaskGroup::drain() {
+	// help out instead of blocking, so nested groups cannot deadlock
+	while (pending.load() > 0)
+		if (!pool.run_one())
+			std::this_thread::yield();
+}
+
+inline void TaskGroup::wait() {
+	drain();
+	std::exception_ptr thrown;
+	{
+		std::lock_guard<std::mutex> guard(error_lock);
+		std::swap(thrown, error);
+	}
+	if (thrown)
+		std::rethrow_exception(thrown);
+}
+
+
+// call f(i) for i in 0..n-1 on the pool and return when all are done
+template <typename F>
+void parallel_for(ThreadPool& pool, int n, F f) {
+	TaskGroup group(pool);
+	for (int i = 0; i < n; i++)
+		group.run([&f, i]() { f(i); });
+	group.wait();
+}
+
+
+// number of pieces to split work into so every thread has a few
+inline int parallel_pieces(ThreadPool& pool) {
+	return 4 * (pool.size() + 1);
+}
+
+
+// concatenate parts into out (in order)
+template <typename T>
+void concat_in_parallel(ThreadPool& pool, const std::vector<std::vector<T>>& parts, std::vector<T>& out) {
+	std::vector<size_t> offsets(parts.size() + 1, 0);
+	for (size_t i = 0; i < parts.size(); i++)
+		offsets[i + 1] = offsets[i] + parts[i].size();
+	out.resize(offsets.back());
+	parallel_for(pool, parts.size(), [&](int i) {
+		std::copy(parts[i].begin(), parts[i].end(), out.begin() + offsets[i]);
+	});
+}
+
+
+// sort v in ascending order on the pool
+template <typename T>
+void sort_in_parallel(ThreadPool& pool, std::vector<T>& v) {
+	if (pool.size() == 0 || v.size() < static_cast<size_t>(parallel_min_items)) {
+		std::sort(v.begin(), v.end());
+		return;
+	}
+	// sort equal chunks, a power of two of them so they merge in pairs
+	int chunks = 1;
+	while (chunks < 2 * (pool.size() + 1))
+		chunks *= 2;
+	size_t n = v.size();
+	std::vector<size_t> bounds(chunks + 1);
+	for (int i = 0; i <= chunks; i++)
+		bounds[i] = n * i / chunks;
+	parallel_for(pool, chunks, [&](int i) {
+		std::sort(v.begin() + bounds[i], v.begin() + bounds[i + 1]);
+	});
+
+	// merge runs of width chunks pairwise until one is left, cutting each
+	// merge into pieces at keys of its left run so all threads stay busy
+	std::vector<T> buffer(n);
+	std::vector<T>* from = &v;
+	std::vector<T>* to = &buffer;
+	for (int width = 1; width < chunks; width *= 2) {
+		int merges = chunks / (2 * width);
+		int pieces = std::max(1, 2 * (pool.size() + 1) / merges);
+		parallel_for(pool, merges * pieces, [&, width, pieces](int task) {
+			int m = task / pieces;
+			int p = task % pieces;
+			typename std::vector<T>::iterator left = from->begin() + bounds[2 * m * width];
+			typename std::vector<T>::iterator mid = from->begin() + bounds[(2 * m + 1) * width];
+			typename std::vector<T>::iterator right = from->begin() + bounds[(2 * m + 2) * width];
+			// piece p takes left run items [a1, a2) and the right run items
+			// below the same cut keys
+			typename std::vector<T>::iterator a1 = left + (mid - left) * p / pieces;
+			typename std::vector<T>::iterator a2 = left + (mid - left) * (p + 1) / pieces;
+			typename std::vector<T>::iterator b1 = p == 0 ? mid : std::lower_bound(mid, right, *a1);
+			typename std::vector<T>::iterator b2 = p == pieces - 1 ? right : std::lower_bound(mid, right, *a2);
+			std::merge(a1, a2, b1, b2, to->begin() + (a1 - from->begin()) + (b1 - mid));
+		});
+		std::swap(from, to);
+	}
+	if (from != &v)
+		v.swap(buffer);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Structural statistics of the binary search tree collections,
+kept up to date by their insert and remove so that stats() is O(1) (unlike
+height(), which walks the whole tree). Monitoring can poll them to spot a
+degenerate tree or unusual rebalancing work.
+*/
+
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <cstring>
+
+
+// the cases of the red-black remove fix up (remove_color_adjust() in
+// dbl_rbt_collection.h), in its numbering
+enum RemoveCase {
+	REMOVE_CASE_1,   // red sibling
+	REMOVE_CASE_2A,  // black sibling with a red outside child
+	REMOVE_CASE_2B,  // black sibling with a red inside child
+	REMOVE_CASE_3A,  // black sibling with black children, red parent
+	REMOVE_CASE_3B,  // black sibling with black children, black parent
+	REMOVE_CASES
+};
+
+
+struct TreeStats {
+	// number of nodes
+	int nodes;
+
+	// black nodes on each path from the root down (0 for a tree that is
+	// not red-black; the tree in rbt_collection.h does not rebalance on
+	// remove, so there it counts the black levels added by inserts)
+	int black_height;
+
+	// deepest depth at which an insert or bulk_load() placed a node since
+	// the last reset, counting the root as 1 like height() (for a plain
+	// BST with no removes since the reset it is the height; the red-black
+	// trees rotate nodes up or down afterwards)
+	int max_depth;
+
+	// single rotations since the last reset (a double rotation is two)
+	long rotations;
+
+	// remove fix up steps since the last reset, by case
+	long remove_cases[REMOVE_CASES];
+};
+
+
+// zero the counters of stats that run since the last reset, leaving the
+// current shape (nodes and black height) alone
+inline void reset_counters(TreeStats& stats) {
+	stats.max_depth = 0;
+	stats.rotations = 0;
+	std::memset(stats.remove_cases, 0, sizeof(stats.remove_cases));
+}
+
+
+// height of the balanced tree bulk_load() builds from n nodes
+inline int balanced_height(int n) {
+	int height = 0;
+	for (; n > 0; n >>= 1)
+		height++;
+	return height;
+}
+
+
+// return stats with every field zero
+inline TreeStats empty_tree_stats() {
+	TreeStats stats;
+	std::memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*
+Greeley Lindberg
+10/17/26
+Description: Non-recursive traversals shared by the binary search tree
+collections. Each works on any node type with key, left and right members
+and keeps its own stack of pending nodes, so walking a tree that has
+degenerated into a long path (e.g. a BST filled with sorted keys) cannot
+overflow the call stack. find_nodes_batch() runs a group of searches side
+by side. inorder_keys_in_parallel() splits the in-order walk
+into subtrees that the threads of a pool walk at the same time.
+*/
+
+#ifndef TREE_TRAVERSAL_H
+#define TREE_TRAVERSAL_H
+
+#include <vector>
+#include <utility>
+#include "thread_pool.h"
+
+
+// each traversal keeps its stack of pending nodes in a local array of this
+// size (enough for any balanced tree that fits in memory), so the stack top
+// can stay in a register, and moves it to the heap only for taller trees
+const int inline_stack_size = 96;
+
+
+// double the capacity of a traversal stack holding top entries, moving it
+// into heap, and return the new stack
+template <typename T>
+T* grow_stack(T* stack, int top, int& capacity, std::vector<T>& heap) {
+	std::vector<T> bigger(stack, stack + top);
+	bigger.resize(2 * capacity);
+	heap.swap(bigger);
+	capacity *= 2;
+	return heap.data();
+}
+
+
+// call f(node) on the nodes of the tree at root in ascending key order,
+// limited to k1 <= key <= k2 when k1 and k2 are set, until f returns false;
+// returns false if f stopped the traversal
+template <typename Node, typename K, typename F>
+bool inorder_nodes(const Node* root, const K* k1, const K* k2, F f) {
+	const Node* inline_stack[inline_stack_size];
+	std::vector<const Node*> heap_stack;
+	const Node** stack = inline_stack;
+	int capacity = inline_stack_size;
+	int top = 0;
+	const Node* curr = root;
+	while (true) {
+		// go down the left spine, skipping subtrees below the range
+		while (curr) {
+			if (k1 && curr->key < *k1)
+				curr = curr->right;
+			else {
+				if (top == capacity)
+					stack = grow_stack(stack, top, capacity, heap_stack);
+				stack[top++] = curr;
+				curr = curr->left;
+			}
+		}
+		if (top == 0)
+			return true;
+		curr = stack[--top];
+		if (k2 && *k2 < curr->key)
+			return true;
+		if (!f(curr))
+			return false;
+		curr = curr->right;
+	}
+}
+
+
+// call f(node) on the nodes of the tree at root in preorder
+template <typename Node, typename F>
+void preorder_nodes(const Node* root, F f) {
+	if (!root)
+		return;
+	const Node* inline_stack[inline_stack_size];
+	std::vector<const Node*> heap_stack;
+	const Node** stack = inline_stack;
+	int capacity = inline_stack_size;
+	int top = 0;
+	stack[top++] = root;
+	while (top > 0) {
+		const Node* curr = stack[--top];
+		f(curr);
+		// right goes first so the left subtree comes off the stack first
+		if (top + 2 > capacity)
+			stack = grow_stack(stack, top, capacity, heap_stack);
+		if (curr->right)
+			stack[top++] = curr->right;
+		if (curr->left)
+			stack[top++] = curr->left;
+	}
+}
+
+
+// return the number of nodes on the longest path down from root
+template <typename Node>
+int tree_height(const Node* root) {
+	if (!root)
+		return 0;
+	int height = 0;
+	// each entry is a node and its depth
+	std::pair<const Node*, int> inline_stack[inline_stack_size];
+	std::vector<std::pair<const Node*, int>> heap_stack;
+	std::pair<const Node*, int>* stack = inline_stack;
+	int capacity = inline_stack_size;
+	int top = 0;
+	stack[top++] = std::make_pair(root, 1);
+	while (top > 0) {
+		std::pair<const Node*, int> curr = stack[--top];
+		if (curr.second > height)
+			height = curr.second;
+		if (top + 2 > capacity)
+			stack = grow_stack(stack, top, capacity, heap_stack);
+		if (curr.first->left)
+			stack[top++] = std::make_pair(curr.first->left, curr.second + 1);
+		if (curr.first->right)
+			stack[top++] = std::make_pair(curr.first->right, curr.second + 1);
+	}
+	return height;
+}
+
+
+// call destroy(node) on every node of the tree at root, using no extra
+// memory (each left child is rotated up until the top node has none, then
+// that node is destroyed and its right subtree is next)
+template <typename Node, typename F>
+void destroy_nodes(Node* root, F destroy) {
+	Node* curr = root;
+	while (curr) {
+		if (curr->left) {
+			Node* left = curr->left;
+			curr->left = left->right;
+			left->right = curr;
+			curr = left;
+		}
+		else {
+			Node* right = curr->right;
+			destroy(curr);
+			curr = right;
+		}
+	}
+}
+
+
+// return a copy of the tree at root, with each node made by create() and
+// assigned from the original (so any color fields come along)
+template <typename Node, typename F>
+Node* clone_nodes(const Node* root, F create) {
+	Node* copy_root = nullptr;
+	if (!root)
+		return copy_root;
+	// each entry is an original node and where to link its copy
+	std::pair<const Node*, Node**> inline_stack[inline_stack_size];
+	std::vector<std::pair<const Node*, Node**>> heap_stack;
+	std::pair<const Node*, Node**>* stack = inline_stack;
+	int capacity = inline_stack_size;
+	int top = 0;
+	stack[top++] = std::make_pair(root, &copy_root);
+	while (top > 0) {
+		std::pair<const Node*, Node**> curr = stack[--top];
+		Node* ptr = create();
+		*ptr = *curr.first;
+		ptr->left = nullptr;
+		ptr->right = nullptr;
+		*curr.second = ptr;
+		if (top + 2 > capacity)
+			stack = grow_stack(stack, top, capacity, heap_stack);
+		if (curr.first->right)
+			stack[top++] = std::make_pair(curr.first->right, &ptr->right);
+		if (curr.first->left)
+			stack[top++] = std::make_pair(curr.first->left, &ptr->left);
+	}
+	return copy_root;
+}
+
+// call f(i, node) for each keys[i] in keys[0..n) found in the search tree at
+// root (the first node on its search path with an equal key); the searches
+// of group keys at a time advance together a level per round, prefetching
+// each next node, so the cache misses of the group overlap
+template <typename Node, typename K, typename F>
+void find_nodes_batch(const Node* root, const K* keys, int n, int group, F f) {
+	if (!root)
+		return;
+	std::vector<const Node*> curr(group);
+	std::vector<int> live(group);
+	for (int base = 0; base < n; base += group) {
+		int count = n - base < group ? n - base : group;
+		for (int j = 0; j < count; j++) {
+			curr[j] = root;
+			live[j] = j;
+		}
+		// keep the searches still going at the front of live
+		while (count > 0) {
+			int still = 0;
+			for (int a = 0; a < count; a++) {
+				int j = live[a];
+				const K& key = keys[base + j];
+				const Node* node = curr[j];
+				if (key == node->key) {
+					f(base + j, node);
+					continue;
+				}
+				node = key < node->key ? node->left : node->right;
+				if (!node)
+					continue;
+				__builtin_prefetch(node);
+				curr[j] = node;
+				live[still++] = j;
+			}
+			count = still;
+		}
+	}
+}
+
+
+// append to pieces, in ascending key order, the nodes in the top depth
+// levels of the tree at root (as single nodes) and the subtrees below them,
+// skipping any that are all outside k1..k2 when k1 and k2 are set
+template <typename Node, typename K>
+void split_inorder(const Node* root, int depth, const K* k1, const K* k2,
+std::vector<std::pair<const Node*, bool>>& pieces) {
+	if (!root)
+		return;
+	if (depth == 0) {
+		pieces.push_back(std::make_pair(root, false));
+		return;
+	}
+	bool above = k1 && root->key < *k1;
+	bool below = k2 && *k2 < root->key;
+	if (!above)
+		split_inorder(root->left, depth - 1, k1, k2, pieces);
+	if (!above && !below)
+		pieces.push_back(std::make_pair(root, true));
+	if (!below)
+		split_inorder(root->right, depth - 1, k1, k2, pieces);
+}
+
+
+// set keys to the keys of the tree at root in ascending order (limited to
+// k1 <= key <= k2 when k1 and k2 are set), walking its subtrees on pool
+template <typename Node, typename K>
+void inorder_keys_in_parallel(ThreadPool& pool, const Node* root, const K* k1, const K* k2,
+std::vector<K>& keys) {
+	// enough subtrees for each thread to steal a few
+	int depth = 0;
+	while ((1 << depth) < parallel_pieces(pool))
+		depth++;
+	std::vector<std::pair<const Node*, bool>> pieces;
+	split_inorder(root, depth, k1, k2, pieces);
+	std::vector<std::vector<K>> parts(pieces.size());
+	parallel_for(pool, pieces.size(), [&](int i) {
+		if (pieces[i].second)
+			parts[i].push_back(pieces[i].first->key);
+		else
+			inorder_nodes(pieces[i].first, k1, k2, [&parts, i](const Node* ptr) {
+				parts[i].push_back(ptr->key);
+				return true;
+			});
+	});
+	concat_in_parallel(pool, parts, keys);
+}
+
+#endif
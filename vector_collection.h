@@ -2,7 +2,8 @@
 Greeley Lindberg
 9/24/19, hw3
 Description: Concrete class implementation of Collection using vectors.
-Member functions are defined below.
+Member functions are defined below. Columnar picks the layout of the pairs
+(see kv_storage.h).
 */
 
 #ifndef VECTOR_COLLECTION_H
@@ -10,9 +11,12 @@ Member functions are defined below.
 
 #include <vector>
 #include <algorithm>
+#include <utility>
 #include "collection.h"
+#include "kv_storage.h"
+#include "instrumentation.h"
 
-template<typename K, typename V>
+template<typename K, typename V, bool Columnar = columnar_by_default<K,V>::value>
 class VectorCollection : public Collection <K,V>
 {
 	public:
@@ -20,6 +24,14 @@ class VectorCollection : public Collection <K,V>
 	// insert a key-value pair into the collection
 	void insert(const K& key, const V& val);
 
+	// insert a key-value pair, moving the key and value into the collection
+	void insert(K&& key, V&& val);
+
+	// insert a key-value pair with the key forwarded from key and the value
+	// constructed in place from args
+	template <typename KArg, typename... Args>
+	void emplace(KArg&& key, Args&&... args);
+
 	// remove a key-value pair from the collection
 	void remove(const K& key);
 
@@ -35,98 +47,150 @@ class VectorCollection : public Collection <K,V>
 	// return all of the keys in ascending (sorted) order
 	void sort(std::vector<K>& keys) const;
 
+	// keys() and sort() with the keys copied and sorted on pool
+	void parallel_keys(std::vector<K>& keys, ThreadPool& pool) const;
+	void parallel_sort(std::vector<K>& keys, ThreadPool& pool) const;
+
 	// return the number of keys in collection
 	int size() const;
 
+	// call visitor on each key-value pair until it returns false
+	void visit(const std::function<bool(const K&, const V&)>& visitor) const;
+
+	// call visitor on each key-value pair with k1 <= key <= k2
+	// until it returns false
+	void visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const;
+
 	private:
-	std::vector<std::pair<K,V>> kv_list;
+	// key-value pairs in insertion order (keys in their own array when
+	// Columnar, so the linear searches only read keys; see kv_storage.h)
+	KVStorage<K,V,Columnar> kv_list;
 
 };
 
 
-template<typename K, typename V>
-void VectorCollection <K,V>::insert(const K& key , const V& val)
+template<typename K, typename V, bool Columnar>
+void VectorCollection <K,V,Columnar>::insert(const K& key , const V& val)
 {
-	std::pair<K,V> p(key, val);
-	kv_list.push_back(p);
+	COLLECTION_OP("Vector", OP_INSERT);
+	kv_list.emplace_back(key, val);
 }
 
 
-template<typename K, typename V>
-void VectorCollection<K,V>::remove(const K& key)
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::insert(K&& key, V&& val)
 {
-	unsigned int i = 0;
-	for(std::pair<K,V> p : kv_list) {
-		if (p.first == key) {
-			kv_list.erase(kv_list.begin() + i);
-			break;
-		}
-		i++;
-	}
+	COLLECTION_OP("Vector", OP_INSERT);
+	kv_list.emplace_back(std::move(key), std::move(val));
 }
 
-template<typename K, typename V>
-bool VectorCollection<K,V>::find(const K& key, V& val) const 
+
+template<typename K, typename V, bool Columnar>
+template <typename KArg, typename... Args>
+void VectorCollection<K,V,Columnar>::emplace(KArg&& key, Args&&... args)
 {
-	unsigned int i = 0;
-	for(std::pair<K,V> p : kv_list) {
-		if (p.first == key) {
-			val = p.second;
-			return true;
-		}
-		i++;
-	}
-	return false;
+	COLLECTION_OP("Vector", OP_INSERT);
+	kv_list.emplace_back(std::forward<KArg>(key), std::forward<Args>(args)...);
+}
+
+
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::remove(const K& key)
+{
+	COLLECTION_OP("Vector", OP_REMOVE);
+	int i = kv_list.find(key, key);
+	if (i >= 0)
+		kv_list.erase(i);
+}
+
+template<typename K, typename V, bool Columnar>
+bool VectorCollection<K,V,Columnar>::find(const K& key, V& val) const 
+{
+	COLLECTION_OP("Vector", OP_FIND);
+	int i = kv_list.find(key, key);
+	if (i < 0)
+		return false;
+	val = kv_list.value(i);
+	return true;
 }
 
-template<typename K, typename V>
-void VectorCollection<K,V>::find(const K& k1, const K& k2, std::vector<K>& keys) const
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::find(const K& k1, const K& k2, std::vector<K>& keys) const
 {
+	COLLECTION_OP("Vector", OP_RANGE);
 	keys.clear();
+	// the keys from the last k1 before the first k2 through that k2, found
+	// in one pass over the keys
 	int begin = -1;
-	int end = kv_list.size();
-	unsigned int i = 0;
-	for(std::pair<K,V> p : kv_list) {
-		if (p.first == k1)
+	for (int i = kv_list.find(k1, k2); i >= 0; i = kv_list.find(k1, k2, i + 1)) {
+		if (kv_list.key(i) == k1)
 			begin = i;
-		if (p.first == k2) {
-			end = i;
-			break;
+		if (kv_list.key(i) == k2) {
+			if (begin >= 0)
+				for (int j = begin; j <= i; j++)
+					keys.push_back(kv_list.key(j));
+			return;
 		}
-		i++;
 	}
-	if (!(end < begin || begin == -1 || end == kv_list.size()))
-		for (int i = begin; i <= end; i++)
-			keys.push_back(kv_list[i].first);
 }
 
-template<typename K, typename V>
-void VectorCollection<K,V>::keys(std::vector<K>& keys) const
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::keys(std::vector<K>& keys) const
 {
-	keys.clear();
-	unsigned int i = 0;
-	for(std::pair<K,V> p : kv_list) {
-		keys.push_back(kv_list[i].first);
-		i++;
-	}
+	kv_list.keys(keys);
 }
 
-template<typename K, typename V>
-void VectorCollection<K,V>::sort(std::vector<K>& keys) const 
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::sort(std::vector<K>& keys) const 
 {
-	keys.clear();
-	unsigned int i = 0;
-	for(std::pair<K,V> p : kv_list) {
-		keys.push_back(kv_list[i].first);
-		i++;
-	}
+	kv_list.keys(keys);
 	std::sort(keys.begin(), keys.end());
 }
 
-template<typename K, typename V>
-int VectorCollection<K,V>::size() const
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::parallel_keys(std::vector<K>& ks, ThreadPool& pool) const
+{
+	if (pool.size() == 0 || kv_list.size() < parallel_min_items) {
+		keys(ks);
+		return;
+	}
+	// each piece copies an equal run of the keys into place
+	size_t n = kv_list.size();
+	int pieces = parallel_pieces(pool);
+	ks.resize(n);
+	parallel_for(pool, pieces, [&](int p) {
+		for (size_t i = n * p / pieces; i < n * (p + 1) / pieces; i++)
+			ks[i] = kv_list.key(i);
+	});
+}
+
+template<typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::parallel_sort(std::vector<K>& ks, ThreadPool& pool) const
+{
+	parallel_keys(ks, pool);
+	sort_in_parallel(pool, ks);
+}
+
+template<typename K, typename V, bool Columnar>
+int VectorCollection<K,V,Columnar>::size() const
 {
 	return kv_list.size();
 }
 
+template <typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::visit(const std::function<bool(const K&, const V&)>& visitor) const
+{
+	for (int i = 0; i < kv_list.size(); i++)
+		if (!visitor(kv_list.key(i), kv_list.value(i)))
+			return;
+}
+
+template <typename K, typename V, bool Columnar>
+void VectorCollection<K,V,Columnar>::visit(const K& k1, const K& k2, const std::function<bool(const K&, const V&)>& visitor) const
+{
+	for (int i = 0; i < kv_list.size(); i++)
+		if (kv_list.key(i) >= k1 && kv_list.key(i) <= k2 && !visitor(kv_list.key(i), kv_list.value(i)))
+			return;
+}
+
 #endif